@@ -0,0 +1,154 @@
+#include "Regression.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+/* Identifies golden files, followed by width, height and maxIterations as 32-bit integers and the runs of equal
+* iteration counts. A run is the difference of its count to the previous run's count, zigzag encoded, and its length
+* minus one, both as variable-length integers. */
+static const char goldenMagic[4] = { 'M', 'B', 'R', 'L' };
+/* Identifies golden files of continuous counts, followed by the same header and the samples as floats. */
+static const char smoothMagic[4] = { 'M', 'B', 'S', 'M' };
+/* Distance in pixels between the samples of a smooth golden file. */
+static const uint smoothStride = 8;
+
+/* Appends an unsigned integer with 7 bits per byte, the high bit marks that more bytes follow. */
+static void WriteVarint(std::string& data, unsigned int value) {
+	while (value >= 0x80) {
+		data += (char)(value | 0x80);
+		value >>= 7;
+	}
+	data += (char)value;
+}
+
+/* Reads an integer written by WriteVarint, false at the end of the stream or if it does not fit. */
+static bool ReadVarint(std::istream& file, unsigned int& value) {
+	value = 0;
+	for (int shift = 0; shift < 35; shift += 7) {
+		int byte = file.get();
+		if (byte == EOF) return false;
+		value |= (unsigned int)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) return true;
+	}
+	return false;
+}
+
+/* Opens a golden file and checks its magic and header. */
+static bool OpenGolden(std::ifstream& file, const char* path, const char* expectedMagic, uint width, uint height, int maxIterations) {
+	file.open(path, std::ios::in | std::ios::binary);
+	if (!file.is_open()) return false;
+
+	char magic[4];
+	int header[3];
+	file.read(magic, sizeof(magic));
+	file.read((char*)header, sizeof(header));
+	if (!file || !std::equal(magic, magic + 4, expectedMagic)) return false;
+	return header[0] == (int)width && header[1] == (int)height && header[2] == maxIterations;
+}
+
+/* Writes the magic, the header and the data of a golden file. */
+static bool WriteGolden(const char* path, const char* magic, uint width, uint height, int maxIterations, const char* data, size_t size) {
+	std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Could not write golden file " << path << "." << std::endl;
+		return false;
+	}
+
+	int header[3] = { (int)width, (int)height, maxIterations };
+	file.write(magic, 4);
+	file.write((const char*)header, sizeof(header));
+	file.write(data, size);
+	return file.good();
+}
+
+bool SaveGolden(const char* path, uint width, uint height, int maxIterations, const int* iterations) {
+	std::string data;
+	size_t pixels = (size_t)width * height;
+	int previous = 0;
+	for (size_t i = 0; i < pixels;) {
+		size_t end = i + 1;
+		while (end < pixels && iterations[end] == iterations[i]) end++;
+		int delta = iterations[i] - previous;
+		WriteVarint(data, ((unsigned int)delta << 1) ^ (unsigned int)(delta >> 31));
+		WriteVarint(data, (unsigned int)(end - i - 1));
+		previous = iterations[i];
+		i = end;
+	}
+	return WriteGolden(path, goldenMagic, width, height, maxIterations, data.data(), data.size());
+}
+
+bool LoadGolden(const char* path, uint width, uint height, int maxIterations, std::vector<int>& iterations) {
+	std::ifstream file;
+	if (!OpenGolden(file, path, goldenMagic, width, height, maxIterations)) return false;
+
+	iterations.clear();
+	iterations.reserve((size_t)width * height);
+	int previous = 0;
+	while (iterations.size() < (size_t)width * height) {
+		unsigned int delta, length;
+		if (!ReadVarint(file, delta) || !ReadVarint(file, length) || length >= width * height - iterations.size()) return false;
+		previous += (int)(delta >> 1) ^ -(int)(delta & 1);
+		iterations.insert(iterations.end(), length + 1, previous);
+	}
+	return true;
+}
+
+IterationDiff CompareIterations(const std::vector<int>& iterations, const std::vector<int>& golden) {
+	IterationDiff diff;
+	for (size_t i = 0; i < golden.size(); i++) {
+		int a = iterations[i], b = golden[i];
+		if (a == b) continue;
+		diff.differing++;
+		if ((a < 0) != (b < 0)) diff.misclassified++;
+		else diff.maxDifference = std::max(diff.maxDifference, std::abs(a - b));
+	}
+	return diff;
+}
+
+bool SaveSmoothGolden(const char* path, uint width, uint height, int maxIterations, const float* smooth) {
+	std::vector<float> samples;
+	for (uint y = 0; y < height; y += smoothStride)
+		for (uint x = 0; x < width; x += smoothStride) samples.push_back(smooth[x + y * width]);
+	return WriteGolden(path, smoothMagic, width, height, maxIterations, (const char*)samples.data(), sizeof(float) * samples.size());
+}
+
+bool LoadSmoothGolden(const char* path, uint width, uint height, int maxIterations, std::vector<float>& samples) {
+	std::ifstream file;
+	if (!OpenGolden(file, path, smoothMagic, width, height, maxIterations)) return false;
+
+	samples.resize((size_t)((width + smoothStride - 1) / smoothStride) * ((height + smoothStride - 1) / smoothStride));
+	file.read((char*)samples.data(), sizeof(float) * samples.size());
+	return file.good();
+}
+
+SmoothDiff CompareSmooth(const float* smooth, uint width, uint height, const std::vector<float>& samples) {
+	SmoothDiff diff;
+	size_t i = 0;
+	for (uint y = 0; y < height; y += smoothStride)
+		for (uint x = 0; x < width; x += smoothStride, i++) {
+			float a = smooth[x + y * width], b = samples[i];
+			if ((a < 0.0f) != (b < 0.0f)) diff.misclassified++;
+			else diff.maxDifference = std::max(diff.maxDifference, std::abs(a - b));
+		}
+	return diff;
+}
+
+std::map<std::string, double> LoadBaseline(const char* path) {
+	std::map<std::string, double> baseline;
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		std::cerr << "Could not read baseline " << path << "." << std::endl;
+		return baseline;
+	}
+
+	// The JSON is written with one benchmark per line.
+	const std::string nameKey = "\"name\": \"", timeKey = "\"median_time\": ";
+	std::string line;
+	while (std::getline(file, line)) {
+		size_t name = line.find(nameKey), time = line.find(timeKey);
+		if (name == std::string::npos || time == std::string::npos) continue;
+		name += nameKey.size();
+		baseline[line.substr(name, line.find('"', name) - name)] = std::stod(line.substr(time + timeKey.size()));
+	}
+	return baseline;
+}
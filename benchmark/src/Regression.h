@@ -0,0 +1,76 @@
+#pragma once
+#include "tmpl/incl.h"
+#include <map>
+
+/*
+* Correctness and performance regression checks of the benchmark: iteration buffers are compared against golden files
+* rendered by the reference CPU kernel, frame times against a baseline JSON written by an earlier run.
+*/
+
+/* Difference between an iteration buffer and its golden buffer. */
+struct IterationDiff {
+	/* Number of pixels with a different iteration count. */
+	size_t differing = 0;
+	/* Number of pixels whose inside/outside classification differs. */
+	size_t misclassified = 0;
+	/* Largest difference in iterations of pixels outside the set in both buffers. */
+	int maxDifference = 0;
+};
+
+/* Difference between continuous iteration counts and their golden samples. */
+struct SmoothDiff {
+	/* Number of samples whose inside/outside classification differs. */
+	size_t misclassified = 0;
+	/* Largest difference of samples outside the set in both buffers. */
+	float maxDifference = 0.0f;
+};
+
+/** Writes an iteration buffer as a golden file, runs of equal counts are stored once.
+* @param[in] path				Output file path.
+* @param[in] width				Image width.
+* @param[in] height				Image height.
+* @param[in] maxIterations		Maximum number of iterations the buffer was computed with.
+* @param[in] iterations			Iteration count per pixel, of size width * height.
+* @returns						true if the file was written.
+*/
+bool SaveGolden(const char* path, uint width, uint height, int maxIterations, const int* iterations);
+
+/** Reads a golden file.
+* @param[in] path				Golden file path.
+* @param[in] width				Expected image width.
+* @param[in] height				Expected image height.
+* @param[in] maxIterations		Expected maximum number of iterations.
+* @param[out] iterations		Iteration count per pixel.
+* @returns						false if the file is missing or was rendered with other parameters.
+*/
+bool LoadGolden(const char* path, uint width, uint height, int maxIterations, std::vector<int>& iterations);
+
+/** Compares an iteration buffer to its golden buffer of the same size. */
+IterationDiff CompareIterations(const std::vector<int>& iterations, const std::vector<int>& golden);
+
+/** Writes continuous iteration counts as a golden file. Only every 8th pixel in both directions is stored, the counts
+* do not compress and a full buffer would be as large as the image.
+* @param[in] path				Output file path.
+* @param[in] width				Image width.
+* @param[in] height				Image height.
+* @param[in] maxIterations		Maximum number of iterations the buffer was computed with.
+* @param[in] smooth				Continuous iteration count per pixel, of size width * height.
+* @returns						true if the file was written.
+*/
+bool SaveSmoothGolden(const char* path, uint width, uint height, int maxIterations, const float* smooth);
+
+/** Reads a golden file of continuous iteration counts, parameters as for LoadGolden.
+* @param[out] samples			Stored samples, to be passed to CompareSmooth.
+*/
+bool LoadSmoothGolden(const char* path, uint width, uint height, int maxIterations, std::vector<float>& samples);
+
+/** Compares continuous iteration counts at the pixels stored in their golden file.
+* @param[in] smooth				Continuous iteration count per pixel, of size width * height.
+* @param[in] width				Image width.
+* @param[in] height				Image height.
+* @param[in] samples			Golden samples read by LoadSmoothGolden.
+*/
+SmoothDiff CompareSmooth(const float* smooth, uint width, uint height, const std::vector<float>& samples);
+
+/** Reads the median frame time (in ms) per benchmark name from JSON written with --json. */
+std::map<std::string, double> LoadBaseline(const char* path);
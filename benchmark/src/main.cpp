@@ -0,0 +1,387 @@
+#include "fractal/Mandelbrot.h"
+#include "fractal/Formula.h"
+#include "fractal/FormulaJit.h"
+#include "fractal/Lyapunov.h"
+#include "fractal/clMandelbrot.h"
+#include "Regression.h"
+#include "tmpl/PerfCounters.h"
+#include "tmpl/Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#include <omp.h>
+
+/*
+* Standalone benchmark of the escape-time kernels. Every kernel variant renders a fixed set of views and reports
+* throughput in Mpixels/s, Giterations/s and cycles per iteration. The Lyapunov variants render their own views, for
+* them an iteration is one step of the logistic map.
+*
+* Usage: benchmark [--filter=substring] [--min_time=seconds] [--json=path] [--width=n] [--height=n] [--kernel_path=path] [--no_opencl]
+*                  [--trace=path] [--perf] [--golden=dir] [--update_golden] [--baseline=path] [--max_regression=fraction]
+*
+* With --perf the hardware counters of the compute phase are read through perf_event_open, which only exists on Linux. The
+* shipped MSBuild project targets Windows, where --perf only prints a warning. For OpenCL variants the counters count the
+* host side only.
+*
+* Regression gate: with --golden every result is compared against the golden iteration buffers in the directory, rendered by
+* the reference CPU kernel (--update_golden writes them), Lyapunov variants are not checked. Variants with continuous counts
+* are compared against golden continuous counts instead. With --baseline the median times are compared against a JSON file
+* written by an earlier run with --json, slower than the baseline by more than --max_regression (default 0.1) fails.
+* The exit code is 1 if any check failed.
+*
+* The goldens of the default size and a baseline of the CPU variants are checked in, run from the benchmark directory with
+* "--no_opencl --golden=golden --baseline=baseline.json". The baseline was measured on a single machine, regenerate it with
+* --json on the machine running the gate. The goldens were rendered without FMA contraction, like MSVC does by default.
+*/
+
+/* A canonical view to benchmark. */
+struct BenchmarkView {
+	const char* name;
+	View view;
+	int maxIterations;
+	/* Deeper than single precision can resolve, single precision variants are not verified. */
+	bool deep;
+	/* A/B sequence of a Lyapunov view, maxIterations is the number of accumulated steps. */
+	const char* sequence;
+};
+
+/* A kernel variant to benchmark. */
+struct KernelVariant {
+	const char* name;
+	/* Micro benchmarks run on a small image on a single thread, macro benchmarks on the full image. */
+	bool micro;
+	/* Number of threads working on a frame, used for cycles per iteration. */
+	int threads;
+	/* Fraction of pixels that may differ from the golden buffer, fast-math kernels do not match the reference exactly.
+	* For variants with continuous counts the largest difference of a continuous count instead. */
+	double tolerance;
+	bool singlePrecision;
+	std::function<void(const BenchmarkView& view, uint width, uint height, int* iterations)> run;
+	/* Renders the Lyapunov views instead of the escape-time views. */
+	bool lyapunov = false;
+	/* Continuous iteration counts written by run, checked instead of the integer counts. */
+	const std::vector<float>* smooth = nullptr;
+};
+
+/* Results of a single benchmark. */
+struct BenchmarkResult {
+	std::string name;
+	int repetitions;
+	/* Frame times in ms. */
+	double minTime, medianTime, meanTime;
+	double mpixelsPerSecond, gigaIterationsPerSecond, cyclesPerIteration;
+	unsigned long long iterations;
+	/* Hardware counters averaged over the repetitions, valid if hasCounters. */
+	bool hasCounters = false;
+	double ipc, branchMissesPerPixel, l1MissesPerPixel, llcMissesPerPixel, licenseStallFraction;
+};
+
+static const BenchmarkView views[] = {
+	{ "full", { -0.75, 0.0, 1.5 }, 256, false },
+	// The center used in DemoApp::Tick.
+	{ "seahorse", { -0.75, 0.1, 0.05 }, 256, false },
+	{ "elephant", { 0.275, 0.0, 0.01 }, 512, false },
+	// Just right of the cusp of the period-3 minibrot, deeper than single precision resolves. About a fifth of the pixels
+	// are inside, most others escape after hundreds to thousands of iterations.
+	{ "minibrot", { -1.7495112, -0.0001646047, 1e-6 }, 4096, true },
+	// Inside the main cardioid, every pixel runs to the maximum.
+	{ "interior", { -0.1, 0.0, 0.05 }, 256, false },
+};
+
+/* Lyapunov views in the (a, b) plane, the step counts are multiples of the sequence lengths. */
+static const BenchmarkView lyapunovViews[] = {
+	{ "ab", { 3.4, 3.4, 0.6 }, 512, false, "AB" },
+	{ "aabab", { 3.4, 3.4, 0.6 }, 510, false, "AABAB" },
+	// 'Zircon Zity'.
+	{ "zircon", { 3.3, 3.0, 0.7 }, 516, false, "BBBBBBAAAAAA" },
+	// No compiled kernel, both variants run the table-driven kernel.
+	{ "long", { 3.4, 3.4, 0.6 }, 516, false, "ABBBABAABBAB" },
+};
+
+/* Sum of the iterations of all pixels, pixels inside the set count as maxIterations. */
+unsigned long long CountIterations(const int* iterations, size_t pixels, int maxIterations) {
+	unsigned long long total = 0;
+	for (size_t i = 0; i < pixels; i++) total += iterations[i] < 0 ? maxIterations : iterations[i];
+	return total;
+}
+
+BenchmarkResult RunBenchmark(const KernelVariant& variant, const BenchmarkView& view, uint width, uint height, double minTime, PerfCounters* counters,
+	std::vector<int>& iterations) {
+	iterations.resize(width * height);
+	std::vector<double> times;
+	std::vector<unsigned long long> cycles;
+
+	// Warm-up, also builds OpenCL variants and tunes work sizes.
+	variant.run(view, width, height, iterations.data());
+
+	double total = 0.0;
+	PerfSample perf;
+	while (total < minTime || times.size() < 3) {
+		if (counters) counters->Start();
+		auto sTime = std::chrono::steady_clock::now();
+		unsigned long long sCycles = __rdtsc();
+		variant.run(view, width, height, iterations.data());
+		unsigned long long eCycles = __rdtsc();
+		auto eTime = std::chrono::steady_clock::now();
+		if (counters) {
+			PerfSample sample = counters->Stop();
+			for (int e = 0; e < (int)PerfEvent::Count; e++) {
+				perf.values[e] += sample.values[e];
+				perf.valid[e] = sample.valid[e];
+			}
+		}
+
+		times.push_back(std::chrono::duration<double, std::milli>(eTime - sTime).count());
+		cycles.push_back(eCycles - sCycles);
+		total += times.back() * 1e-3;
+	}
+
+	std::vector<double> sorted = times;
+	std::sort(sorted.begin(), sorted.end());
+	std::sort(cycles.begin(), cycles.end());
+
+	BenchmarkResult result;
+	result.name = std::string(variant.name) + "/" + view.name;
+	result.repetitions = (int)times.size();
+	result.minTime = sorted.front();
+	result.medianTime = sorted[sorted.size() / 2];
+	result.meanTime = total * 1e3 / times.size();
+	result.iterations = CountIterations(iterations.data(), iterations.size(), view.maxIterations);
+	result.mpixelsPerSecond = (double)width * height / (result.medianTime * 1e-3) * 1e-6;
+	result.gigaIterationsPerSecond = (double)result.iterations / (result.medianTime * 1e-3) * 1e-9;
+	result.cyclesPerIteration = (double)cycles[cycles.size() / 2] * variant.threads / (double)result.iterations;
+
+	if (perf.Has(PerfEvent::Cycles)) {
+		// Counters are summed over all repetitions.
+		size_t pixels = (size_t)width * height * times.size();
+		result.hasCounters = true;
+		result.ipc = perf.GetIPC();
+		result.branchMissesPerPixel = perf.GetPerPixel(PerfEvent::BranchMisses, pixels);
+		result.l1MissesPerPixel = perf.GetPerPixel(PerfEvent::L1DMisses, pixels);
+		result.llcMissesPerPixel = perf.GetPerPixel(PerfEvent::LLCMisses, pixels);
+		result.licenseStallFraction = perf.Has(PerfEvent::LicenseStalls) ? perf.Get(PerfEvent::LicenseStalls) / perf.Get(PerfEvent::Cycles) : 0.0;
+	}
+	return result;
+}
+
+/* Path of the golden file of a view rendered at a resolution. */
+std::string GetGoldenPath(const std::string& dir, const BenchmarkView& view, uint width, uint height, bool smooth = false) {
+	return dir + "/" + view.name + "_" + std::to_string(width) + "x" + std::to_string(height) + (smooth ? "_smooth" : "") + ".bin";
+}
+
+void WriteJson(const char* path, const std::vector<BenchmarkResult>& results, uint width, uint height) {
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Could not write " << path << "." << std::endl;
+		return;
+	}
+
+	file << "{\n  \"context\": {\"width\": " << width << ", \"height\": " << height << ", \"threads\": " << omp_get_max_threads() << "},\n";
+	file << "  \"benchmarks\": [";
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchmarkResult& r = results[i];
+		file << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.name << "\", \"repetitions\": " << r.repetitions
+			<< ", \"time_unit\": \"ms\", \"min_time\": " << r.minTime << ", \"median_time\": " << r.medianTime << ", \"mean_time\": " << r.meanTime
+			<< ", \"iterations\": " << r.iterations << ", \"mpixels_per_second\": " << r.mpixelsPerSecond
+			<< ", \"giterations_per_second\": " << r.gigaIterationsPerSecond << ", \"cycles_per_iteration\": " << r.cyclesPerIteration;
+		if (r.hasCounters)
+			file << ", \"ipc\": " << r.ipc << ", \"branch_misses_per_pixel\": " << r.branchMissesPerPixel << ", \"l1d_misses_per_pixel\": " << r.l1MissesPerPixel
+				<< ", \"llc_misses_per_pixel\": " << r.llcMissesPerPixel << ", \"licence_stall_fraction\": " << r.licenseStallFraction;
+		file << "}";
+	}
+	file << "\n  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+	std::string filter, jsonPath, tracePath, goldenDir, baselinePath, kernelPath = "../mandelbrot/assets/kernels/mandelbrot.cl";
+	double minTime = 0.5;
+	uint width = 1080, height = 720, microSize = 128;
+	double maxRegression = 0.1;
+	bool useOpenCL = true, usePerf = false, updateGolden = false;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		auto value = [&arg]() { return arg.substr(arg.find('=') + 1); };
+		if (arg.rfind("--filter=", 0) == 0) filter = value();
+		else if (arg.rfind("--min_time=", 0) == 0) minTime = std::stod(value());
+		else if (arg.rfind("--json=", 0) == 0) jsonPath = value();
+		else if (arg.rfind("--width=", 0) == 0) width = std::stoi(value());
+		else if (arg.rfind("--height=", 0) == 0) height = std::stoi(value());
+		else if (arg.rfind("--kernel_path=", 0) == 0) kernelPath = value();
+		else if (arg.rfind("--trace=", 0) == 0) tracePath = value();
+		else if (arg == "--no_opencl") useOpenCL = false;
+		else if (arg == "--perf") usePerf = true;
+		else if (arg.rfind("--golden=", 0) == 0) goldenDir = value();
+		else if (arg == "--update_golden") updateGolden = true;
+		else if (arg.rfind("--baseline=", 0) == 0) baselinePath = value();
+		else if (arg.rfind("--max_regression=", 0) == 0) maxRegression = std::stod(value());
+		else FATAL_ERROR("Unknown argument %s", arg.c_str());
+	}
+
+	std::vector<KernelVariant> variants;
+	variants.push_back({ "cpu_tile", true, 1, 0.0, false, [](const BenchmarkView& v, uint w, uint h, int* it) {
+		ComputeTile(v.view, w, h, v.maxIterations, 0, 0, w, h, it);
+	} });
+	variants.push_back({ "cpu_omp", false, omp_get_max_threads(), 0.0, false, [](const BenchmarkView& v, uint w, uint h, int* it) {
+		ComputeIterations(v.view, w, h, v.maxIterations, it);
+	} });
+	variants.push_back({ "cpu_formula", false, omp_get_max_threads(), 0.0, false, [](const BenchmarkView& v, uint w, uint h, int* it) {
+		ComputeFormula(v.view, w, h, v.maxIterations, FormulaParams(), it);
+	} });
+	// Needs the system compiler, compiled once before the timing. The generated code never contracts multiply-adds, deep
+	// pixels differ from a reference built with FMA contraction.
+	static FormulaJit jit;
+	if (jit.Compile("z^2 + c") && jit.Wait())
+		variants.push_back({ "cpu_jit", false, omp_get_max_threads(), 0.0001, false, [](const BenchmarkView& v, uint w, uint h, int* it) {
+			jit.Compute(v.view, w, h, v.maxIterations, FormulaParams(), it);
+		} });
+	// The larger bailout radius changes the integer counts, the continuous counts are checked instead.
+	static std::vector<float> smoothIterations;
+	variants.push_back({ "cpu_omp_smooth", false, omp_get_max_threads(), 1e-3, false, [](const BenchmarkView& v, uint w, uint h, int* it) {
+		smoothIterations.resize(w * h);
+		ComputeIterations(v.view, w, h, v.maxIterations, it, smoothIterations.data());
+	}, false, &smoothIterations });
+	for (int table = 0; table < 2; table++)
+		variants.push_back({ table ? "cpu_lyapunov_table" : "cpu_lyapunov", false, omp_get_max_threads(), 0.0, false, [table](const BenchmarkView& v, uint w, uint h, int* it) {
+			static std::vector<float> exponents;
+			exponents.resize(w * h);
+			LyapunovSettings settings;
+			snprintf(settings.sequence, sizeof(settings.sequence), "%s", v.sequence);
+			settings.iterations = v.maxIterations;
+			settings.forceTable = table == 1;
+			ComputeLyapunov(v.view, w, h, settings, exponents.data());
+			// Every pixel runs all steps.
+			std::fill(it, it + w * h, -1);
+		}, true });
+
+	clMandelbrot* cl = useOpenCL ? new clMandelbrot(width, height, kernelPath.c_str()) : nullptr;
+	if (cl) {
+		static const KernelMode modes[2] = { KernelMode::NDRange, KernelMode::Persistent };
+		static const char* names[4] = { "cl_ndrange", "cl_persistent", "cl_ndrange_double", "cl_persistent_double" };
+		cl_device_fp_config doubleConfig = 0;
+		clGetDeviceInfo(cl->GetContext()->GetDeviceID(), CL_DEVICE_DOUBLE_FP_CONFIG, sizeof(doubleConfig), &doubleConfig, NULL);
+		int precisions = doubleConfig ? 2 : 1;
+
+		for (int precision = 0; precision < precisions; precision++)
+			for (int mode = 0; mode < 2; mode++)
+				variants.push_back({ names[precision * 2 + mode], false, 1, precision == 1 ? 0.001 : 0.01, precision == 0, [cl, mode, precision](const BenchmarkView& v, uint w, uint h, int* it) {
+					clMandelbrotSettings& settings = cl->GetSettings();
+					settings.kernelMode = modes[mode];
+					settings.doublePrecision = precision == 1;
+					settings.maxIterations = v.maxIterations;
+					if (cl->IsVariantPending() && !cl->WaitForVariant()) FATAL_ERROR("Failed to build the OpenCL program variant of %s.", v.name);
+					cl->Render(v.view, it);
+				} });
+	}
+
+	// Captures what every thread does, keep the filter narrow as every tile of every repetition is recorded.
+	if (!tracePath.empty()) Tracer::Get().StartCapture();
+
+	PerfCounters* counters = usePerf ? new PerfCounters() : nullptr;
+	if (counters && !counters->IsAvailable()) {
+		delete counters;
+		counters = nullptr;
+	}
+
+	if (updateGolden) {
+		if (goldenDir.empty()) FATAL_ERROR("--update_golden requires --golden=dir.");
+		// The scalar CPU kernel is the reference all other variants are checked against.
+		uint sizes[2][2] = { { width, height }, { microSize, microSize } };
+		for (const BenchmarkView& view : views)
+			for (auto& size : sizes) {
+				std::vector<int> golden(size[0] * size[1]);
+				ComputeIterations(view.view, size[0], size[1], view.maxIterations, golden.data());
+				std::string path = GetGoldenPath(goldenDir, view, size[0], size[1]);
+				if (SaveGolden(path.c_str(), size[0], size[1], view.maxIterations, golden.data())) printf("Wrote %s\n", path.c_str());
+
+				// Variants with continuous counts are macro benchmarks.
+				if (size[0] == microSize && size[1] == microSize) continue;
+				std::vector<float> smooth(size[0] * size[1]);
+				ComputeIterations(view.view, size[0], size[1], view.maxIterations, golden.data(), smooth.data());
+				path = GetGoldenPath(goldenDir, view, size[0], size[1], true);
+				if (SaveSmoothGolden(path.c_str(), size[0], size[1], view.maxIterations, smooth.data())) printf("Wrote %s\n", path.c_str());
+			}
+	}
+	std::map<std::string, double> baseline;
+	if (!baselinePath.empty()) baseline = LoadBaseline(baselinePath.c_str());
+	int failures = 0;
+
+	printf("%-32s %10s %10s %12s %12s %10s", "benchmark", "median ms", "min ms", "Mpixels/s", "Giter/s", "cyc/iter");
+	if (counters) printf(" %6s %10s %10s %10s %8s", "IPC", "brmiss/px", "L1miss/px", "LLCmiss/px", "licence");
+	printf("\n");
+	std::vector<BenchmarkResult> results;
+	for (const KernelVariant& variant : variants) {
+		const BenchmarkView* variantViews = variant.lyapunov ? lyapunovViews : views;
+		size_t viewCount = variant.lyapunov ? sizeof(lyapunovViews) / sizeof(lyapunovViews[0]) : sizeof(views) / sizeof(views[0]);
+		for (size_t v = 0; v < viewCount; v++) {
+			const BenchmarkView& view = variantViews[v];
+			std::string name = std::string(variant.name) + "/" + view.name;
+			if (!filter.empty() && name.find(filter) == std::string::npos) continue;
+
+			uint w = variant.micro ? microSize : width, h = variant.micro ? microSize : height;
+			std::vector<int> iterations;
+			BenchmarkResult r = RunBenchmark(variant, view, w, h, minTime, counters, iterations);
+			printf("%-32s %10.3f %10.3f %12.2f %12.3f %10.2f", r.name.c_str(), r.medianTime, r.minTime, r.mpixelsPerSecond, r.gigaIterationsPerSecond, r.cyclesPerIteration);
+			if (r.hasCounters) printf(" %6.2f %10.3f %10.3f %10.4f %7.2f%%", r.ipc, r.branchMissesPerPixel, r.l1MissesPerPixel, r.llcMissesPerPixel, r.licenseStallFraction * 100.0);
+			printf("\n");
+			results.push_back(r);
+
+			if (!goldenDir.empty() && variant.smooth) {
+				std::vector<float> samples;
+				std::string path = GetGoldenPath(goldenDir, view, w, h, true);
+				if (!LoadSmoothGolden(path.c_str(), w, h, view.maxIterations, samples)) {
+					printf("  FAIL missing or outdated golden file %s\n", path.c_str());
+					failures++;
+				}
+				else {
+					SmoothDiff diff = CompareSmooth(variant.smooth->data(), w, h, samples);
+					if (diff.misclassified || diff.maxDifference > variant.tolerance) {
+						printf("  FAIL continuous counts differ by up to %g (allowed %g), %zu misclassified\n", diff.maxDifference, variant.tolerance, diff.misclassified);
+						failures++;
+					}
+				}
+			}
+			else if (!goldenDir.empty() && !variant.lyapunov && !(view.deep && variant.singlePrecision)) {
+				std::vector<int> golden;
+				std::string path = GetGoldenPath(goldenDir, view, w, h);
+				if (!LoadGolden(path.c_str(), w, h, view.maxIterations, golden)) {
+					printf("  FAIL missing or outdated golden file %s\n", path.c_str());
+					failures++;
+				}
+				else {
+					IterationDiff diff = CompareIterations(iterations, golden);
+					double fraction = (double)diff.differing / golden.size();
+					if (fraction > variant.tolerance) {
+						printf("  FAIL %zu pixels differ (%.3f%%, allowed %.3f%%), %zu misclassified, max difference %i\n",
+							diff.differing, fraction * 100.0, variant.tolerance * 100.0, diff.misclassified, diff.maxDifference);
+						failures++;
+					}
+				}
+			}
+
+			auto base = baseline.find(r.name);
+			if (base != baseline.end() && r.medianTime > base->second * (1.0 + maxRegression)) {
+				printf("  FAIL %.1f%% slower than the baseline (%.3f ms)\n", (r.medianTime / base->second - 1.0) * 100.0, base->second);
+				failures++;
+			}
+		}
+	}
+
+	if (!tracePath.empty()) {
+		Tracer::Get().StopCapture();
+		Tracer::Get().ExportChromeTrace(tracePath.c_str());
+	}
+	if (!jsonPath.empty()) WriteJson(jsonPath.c_str(), results, width, height);
+
+	delete counters;
+	delete cl;
+
+	if (!goldenDir.empty() || !baseline.empty()) printf(failures ? "%i checks failed\n" : "All checks passed\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,136 @@
+/*
+* Compile-time parameters, set per variant through the build options (-D NAME=value).
+*	MAX_ITERATIONS		Maximum number of iterations.
+*	USE_DOUBLE			1 to iterate in double precision, requires cl_khr_fp64.
+*	FORMULA				0 = Mandelbrot, 1 = Burning Ship, 2 = Tricorn.
+*	SMOOTH				1 to write continuous iteration counts, uses a larger bailout radius.
+*/
+#ifndef MAX_ITERATIONS
+#define MAX_ITERATIONS 256
+#endif
+#ifndef USE_DOUBLE
+#define USE_DOUBLE 0
+#endif
+#ifndef FORMULA
+#define FORMULA 0
+#endif
+#ifndef SMOOTH
+#define SMOOTH 0
+#endif
+
+#if SMOOTH
+// Squared bailout radius, 2^16. Must match SMOOTH_BAILOUT on the host.
+#define BAILOUT 65536.0
+#else
+#define BAILOUT 4.0
+#endif
+
+#if USE_DOUBLE
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+typedef double real;
+typedef double2 real2;
+#else
+typedef float real;
+typedef float2 real2;
+#endif
+
+/*
+* Computes the number of iterations for a single pixel.
+* @param[out] r2				|z|^2 after the last iteration.
+* @returns						Iteration count, -1 for pixels inside the set.
+*/
+int Iterate(const uint x, const uint y, const uint width, const uint height, const real2 center, const real zoom, float* r2) {
+	const real x0 = center.x + ((real)x / (real)width - 0.5) * 2.0 * zoom;
+	const real y0 = center.y + ((real)y / (real)height - 0.5) * 2.0 * zoom;
+
+	real xi = 0.0, yi = 0.0;
+	real xx = 0.0, yy = 0.0;
+	int iteration = 0;
+
+	while (xx + yy <= BAILOUT && iteration < MAX_ITERATIONS) {
+#if FORMULA == 1
+		yi = 2.0 * fabs(xi * yi) + y0;
+#elif FORMULA == 2
+		yi = -2.0 * xi * yi + y0;
+#else
+		yi = 2.0 * xi * yi + y0;
+#endif
+		xi = xx - yy + x0;
+		xx = xi * xi;
+		yy = yi * yi;
+		iteration++;
+	}
+
+	*r2 = (float)(xx + yy);
+	return iteration >= MAX_ITERATIONS ? -1 : iteration;
+}
+
+/*
+* Writes the results of a pixel.
+*/
+void Store(__global int* iterations, __global float* smooth, const uint index, const int iteration, const float r2) {
+	iterations[index] = iteration;
+#if SMOOTH
+	// log|z| / log(bailout radius) lies in [1, 2), its log2 is the fraction of the last iteration that was not needed.
+	smooth[index] = iteration < 0 ? -1.0f : (float)iteration - native_log2(native_log2(r2) * (1.0f / 16.0f));
+#endif
+}
+
+/*
+* Computes the number of iterations for every pixel, -1 for pixels inside the set.
+* @param[out] iterations		Iteration count per pixel, of size width * height.
+* @param[out] smooth			Continuous iteration count per pixel, only written when SMOOTH is set.
+* @param[in] width				Render width.
+* @param[in] height				Render height.
+* @param[in] center				Center of the view in the complex plane.
+* @param[in] zoom				Zoom-level, half the width of the view in the complex plane.
+*/
+__kernel void mandelbrot(__global int* iterations, __global float* smooth, const uint width, const uint height, const real2 center, const real zoom) {
+	const uint x = get_global_id(0);
+	const uint y = get_global_id(1);
+	if (x >= width || y >= height) return;
+
+	float r2;
+	const int iteration = Iterate(x, y, width, height, center, zoom, &r2);
+	Store(iterations, smooth, x + y * width, iteration, r2);
+}
+
+/*
+* Persistent-threads variant: a fixed number of work-groups keeps pulling batches of pixels from a global counter until the frame is done,
+* so groups that drew cheap pixels help out instead of idling while a few groups finish the interior.
+* @param[out] iterations		Iteration count per pixel, of size width * height.
+* @param[out] smooth			Continuous iteration count per pixel, only written when SMOOTH is set.
+* @param[in,out] workCounter	Index of the next unclaimed pixel, must be 0 at launch.
+* @param[in] width				Render width.
+* @param[in] height				Render height.
+* @param[in] center				Center of the view in the complex plane.
+* @param[in] zoom				Zoom-level, half the width of the view in the complex plane.
+* @param[in] batchSize			Number of pixels per work-item claimed at once.
+*/
+__kernel void mandelbrot_persistent(__global int* iterations, __global float* smooth, volatile __global int* workCounter, const uint width, const uint height,
+	const real2 center, const real zoom, const int batchSize) {
+	__local int batchStart;
+
+	const int pixels = width * height;
+	const int lid = get_local_id(0);
+	const int groupSize = get_local_size(0);
+
+	while (true) {
+		// One atomic per work-group and batch keeps contention on the counter low.
+		if (lid == 0) batchStart = atomic_add(workCounter, batchSize * groupSize);
+		barrier(CLK_LOCAL_MEM_FENCE);
+		const int start = batchStart;
+		barrier(CLK_LOCAL_MEM_FENCE);
+		if (start >= pixels) return;
+
+		// Neighbouring work-items take neighbouring pixels for coalesced writes.
+		for (int i = 0; i < batchSize; i++) {
+			const int p = start + i * groupSize + lid;
+			if (p < pixels) {
+				float r2;
+				const int iteration = Iterate(p % width, p / width, width, height, center, zoom, &r2);
+				Store(iterations, smooth, p, iteration, r2);
+			}
+		}
+	}
+}
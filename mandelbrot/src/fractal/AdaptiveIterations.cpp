@@ -0,0 +1,37 @@
+#include "AdaptiveIterations.h"
+#include <algorithm>
+#include <cmath>
+
+/* Smallest power of two not below n. */
+static int CeilPowerOfTwo(int n) {
+	int p = 1;
+	while (p < n) p <<= 1;
+	return p;
+}
+
+int AdaptiveIterations::Update(const IterationStats& stats, double zoom) {
+	int minCap = CeilPowerOfTwo(m_Settings.minIterations);
+	int maxCap = std::max(minCap, CeilPowerOfTwo(m_Settings.maxIterations));
+
+	// Detail near the boundary needs more iterations the deeper the view, add the minimum for every decade of zoom.
+	double depth = std::max(0.0, std::log10(1.0 / zoom));
+	int depthCap = std::min(maxCap, CeilPowerOfTwo((int)(minCap * (1.0 + depth))));
+
+	// Only react to frames computed with the current cap, the statistics of older frames are stale.
+	if (stats.maxIterations == m_Cap) {
+		if (stats.lateEscapeFraction > m_Settings.raiseThreshold) m_Cap *= 2;
+		else if (stats.lateEscapeFraction < m_Settings.lowerThreshold) {
+			// The histogram tells how many pixels would escape late with half the cap, don't lower if that would raise it again.
+			unsigned long long pixels = 0, lateAtHalf = 0;
+			int lateBins = (int)(HISTOGRAM_BINS * LATE_ESCAPE_FRACTION / 2.0f);
+			for (int b = 0; b < HISTOGRAM_BINS; b++) {
+				pixels += stats.histogram[b];
+				if (b >= HISTOGRAM_BINS / 2 - lateBins && b < HISTOGRAM_BINS / 2) lateAtHalf += stats.histogram[b];
+			}
+			if (pixels && (float)lateAtHalf / pixels <= m_Settings.raiseThreshold) m_Cap /= 2;
+		}
+	}
+
+	m_Cap = std::min(maxCap, std::max(std::max(minCap, depthCap), m_Cap));
+	return m_Cap;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "IterationStats.h"
+
+/* Bounds and thresholds of the adaptive iteration cap. */
+struct AdaptiveIterationSettings {
+	bool enabled = false;
+	/* Bounds of the cap, rounded to powers of two. */
+	int minIterations = 64, maxIterations = 16384;
+	/* Raise the cap when more than this fraction of the pixels escapes late, the boundary is cut off. */
+	float raiseThreshold = 0.002f;
+	/* Lower the cap when fewer than this fraction of the pixels escapes late, iterations are wasted on the interior. */
+	float lowerThreshold = 0.0002f;
+};
+
+/** Picks the iteration cap for the next frame from the zoom depth and the escape statistics of the previous frame.
+* The cap moves in powers of two, so the OpenCL backend only ever needs a handful of program variants.
+*/
+class AdaptiveIterations {
+
+public:
+	/** Updates the cap from a computed frame.
+	* @param[in] stats			Statistics of the last frame, ignored if it was not computed with the current cap.
+	* @param[in] zoom			Zoom of the next frame, deeper views get a higher minimum cap.
+	* @returns					Cap for the next frame.
+	*/
+	int Update(const IterationStats& stats, double zoom);
+
+	/** Retrieves the cap for the next frame. */
+	int GetCap() const { return m_Cap; }
+	AdaptiveIterationSettings& GetSettings() { return m_Settings; }
+
+private:
+	AdaptiveIterationSettings m_Settings;
+	int m_Cap = 256;
+};
@@ -0,0 +1,77 @@
+#include "Antialiasing.h"
+#include "tmpl/Trace.h"
+#include <algorithm>
+#include <cmath>
+
+/** Hashes a pixel and sample index to a number in [0, 1), the jitter is fixed per pixel so still frames do not flicker. */
+static inline float Jitter(uint pixel, uint sample) {
+	uint h = pixel * 0x9e3779b9u ^ (sample + 0x7f4a7c15u) * 0x85ebca6bu;
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return (float)(h >> 8) * (1.0f / (1 << 24));
+}
+
+/** Whether two neighbouring pixels differ enough to resample both. */
+static inline bool IsEdge(int a, int b, const Color& ca, const Color& cb, const AntialiasSettings& settings) {
+	if ((a < 0) != (b < 0)) return true;
+	if (std::abs(a - b) > settings.iterationThreshold) return true;
+	return std::abs(ca.r - cb.r) + std::abs(ca.g - cb.g) + std::abs(ca.b - cb.b) > settings.colorThreshold;
+}
+
+void AntialiasEdges(const View& view, uint width, uint height, int maxIterations, bool smooth, const int* iterations,
+	const AntialiasSettings& settings, const SampleShader& shade, Color* colors, AntialiasStats& stats, const float* distance) {
+	TRACE_SCOPE("cpu", "antialias");
+	const int n = std::max(settings.samplesPerAxis, 1);
+	std::vector<uint> edges;
+
+	// Find the edge pixels before any color is replaced.
+#pragma omp parallel
+	{
+		std::vector<uint> local;
+#pragma omp for schedule(static)
+		for (int y = 0; y < (int)height; y++)
+			for (uint x = 0; x < width; x++) {
+				uint p = x + y * width;
+				bool edge = (distance && distance[p] >= 0.0f && distance[p] < settings.distanceThreshold) ||
+					(x > 0 && IsEdge(iterations[p], iterations[p - 1], colors[p], colors[p - 1], settings)) ||
+					(x + 1 < width && IsEdge(iterations[p], iterations[p + 1], colors[p], colors[p + 1], settings)) ||
+					(y > 0 && IsEdge(iterations[p], iterations[p - width], colors[p], colors[p - width], settings)) ||
+					(y + 1 < (int)height && IsEdge(iterations[p], iterations[p + width], colors[p], colors[p + width], settings));
+				if (edge) local.push_back(p);
+			}
+#pragma omp critical
+		edges.insert(edges.end(), local.begin(), local.end());
+	}
+
+	// Resample in place, the colors are no longer read as neighbours. Pixels near the set cost far more, hand them out in small chunks.
+	const double pixelX = 2.0 * view.zoom / width, pixelY = 2.0 * view.zoom / height;
+	const float weight = 1.0f / (float)(n * n);
+#pragma omp parallel for schedule(dynamic, 64)
+	for (long long e = 0; e < (long long)edges.size(); e++) {
+		uint p = edges[e];
+		uint x = p % width, y = p / width;
+		// Top-left corner of the pixel area centered on the primary sample of ComputeTile.
+		double px = view.centerX + ((double)x / (double)width - 0.5) * 2.0 * view.zoom - 0.5 * pixelX;
+		double py = view.centerY + ((double)y / (double)height - 0.5) * 2.0 * view.zoom - 0.5 * pixelY;
+
+		float r = 0.0f, g = 0.0f, b = 0.0f;
+		for (int sy = 0; sy < n; sy++)
+			for (int sx = 0; sx < n; sx++) {
+				uint s = sx + sy * n;
+				double cx = px + ((double)sx + Jitter(p, 2 * s)) / n * pixelX;
+				double cy = py + ((double)sy + Jitter(p, 2 * s + 1)) / n * pixelY;
+				float value = -1.0f;
+				int iteration = IteratePoint(cx, cy, maxIterations, smooth ? &value : nullptr);
+				Color c = shade(iteration, value);
+				r += c.r, g += c.g, b += c.b;
+			}
+		colors[p] = Color(r * weight, g * weight, b * weight);
+	}
+
+	stats.resampled = edges.size();
+	stats.resampledFraction = (float)edges.size() / (float)(width * height);
+	stats.samples = (unsigned long long)edges.size() * n * n;
+}
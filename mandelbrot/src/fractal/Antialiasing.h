@@ -0,0 +1,46 @@
+#pragma once
+#include "Mandelbrot.h"
+#include <functional>
+
+/* Settings of the adaptive anti-aliasing pass. */
+struct AntialiasSettings {
+	bool enabled = false;
+	/* Edge pixels are resampled with samplesPerAxis x samplesPerAxis jittered samples, one per stratum of the pixel. */
+	int samplesPerAxis = 4;
+	/* Iteration difference to a neighbour above which a pixel is an edge. Escaped and interior neighbours always are. */
+	int iterationThreshold = 2;
+	/* Summed RGB difference to a neighbour above which a pixel is an edge. */
+	float colorThreshold = 0.15f;
+	/* Estimated distance to the set in pixels below which a pixel is an edge, when distance estimates are available. */
+	float distanceThreshold = 1.0f;
+};
+
+/* Statistics of the last anti-aliasing pass. */
+struct AntialiasStats {
+	/* Number of pixels that were resampled and their fraction of the image. */
+	size_t resampled = 0;
+	float resampledFraction = 0.0f;
+	/* Number of points that were iterated. */
+	unsigned long long samples = 0;
+};
+
+/* Colors a sample from its iteration count and continuous iteration count, both -1 inside the set. */
+typedef std::function<Color(int iteration, float smooth)> SampleShader;
+
+/** Anti-aliases a computed frame by supersampling only the pixels whose iteration count or color differs from one of
+* their four neighbours by more than the thresholds, or that lie close to the set according to the distance estimate.
+* Costs samplesPerAxis^2 iterations per edge pixel instead of per pixel.
+* @param[in] view				Region of the complex plane the frame was computed for.
+* @param[in] width				Image width.
+* @param[in] height				Image height.
+* @param[in] maxIterations		Maximum number of iterations the frame was computed with.
+* @param[in] smooth				Whether the samples are shaded with continuous iteration counts.
+* @param[in] iterations			Iteration count per pixel, -1 inside the set. Of size width * height.
+* @param[in] settings			Thresholds and sample count.
+* @param[in] shade				Colors a sample, must be safe to call from multiple threads.
+* @param[in,out] colors			Colors of the frame, edge pixels are replaced by the average of their samples.
+* @param[out] stats				Number of resampled pixels.
+* @param[in] distance			Optional estimated distance to the set per pixel in pixels, -1 inside the set.
+*/
+void AntialiasEdges(const View& view, uint width, uint height, int maxIterations, bool smooth, const int* iterations,
+	const AntialiasSettings& settings, const SampleShader& shade, Color* colors, AntialiasStats& stats, const float* distance = nullptr);
@@ -0,0 +1,152 @@
+#include "Buddhabrot.h"
+#include "tmpl/Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+Buddhabrot::Buddhabrot(uint width, uint height) : m_Width(width), m_Height(height), m_View{ -0.5, 0.0, 1.5 } {
+	const size_t planes = (size_t)BUDDHABROT_CHANNELS * width * height;
+	m_Threads.resize(omp_get_max_threads());
+	m_ThreadHistograms.resize(m_Threads.size() * planes);
+	m_Histogram.resize(planes);
+	Reset(m_View, m_Settings);
+}
+
+void Buddhabrot::Reset(const View& view, const BuddhabrotSettings& settings) {
+	m_View = view;
+	m_Settings = settings;
+	m_Stats = BuddhabrotStats();
+	std::fill(m_ThreadHistograms.begin(), m_ThreadHistograms.end(), 0.0f);
+	std::fill(m_Histogram.begin(), m_Histogram.end(), 0.0);
+	for (size_t t = 0; t < m_Threads.size(); t++) {
+		m_Threads[t].rng.seed((unsigned int)(t * 7919 + 1));
+		m_Threads[t].current = Orbit();
+	}
+}
+
+void Buddhabrot::TraceOrbit(double cx, double cy, Orbit& orbit) const {
+	orbit.cx = cx, orbit.cy = cy;
+	orbit.pixels.clear();
+	orbit.channels = 0;
+	orbit.contribution = 0.0f;
+
+	// Points in the main cardioid and the period-2 bulb never escape.
+	double q = (cx - 0.25) * (cx - 0.25) + cy * cy;
+	if (q * (q + (cx - 0.25)) <= 0.25 * cy * cy || (cx + 1.0) * (cx + 1.0) + cy * cy <= 0.0625) return;
+
+	int limit = *std::max_element(m_Settings.maxIterations, m_Settings.maxIterations + BUDDHABROT_CHANNELS);
+	const double scaleX = m_Width / (2.0 * m_View.zoom), scaleY = m_Height / (2.0 * m_View.zoom);
+	double x = 0.0, y = 0.0, xx = 0.0, yy = 0.0;
+	int iteration = 0;
+	while (xx + yy <= 4.0 && iteration < limit) {
+		y = 2.0 * x * y + cy;
+		x = xx - yy + cx;
+		xx = x * x;
+		yy = y * y;
+		iteration++;
+
+		// Inverse of the pixel to complex plane mapping of ComputeTile.
+		double px = (x - m_View.centerX) * scaleX + 0.5 * m_Width, py = (y - m_View.centerY) * scaleY + 0.5 * m_Height;
+		if (px >= 0.0 && py >= 0.0 && px < m_Width && py < m_Height) orbit.pixels.push_back((uint)px + (uint)py * m_Width);
+	}
+	if (xx + yy <= 4.0) {
+		orbit.pixels.clear();
+		return;
+	}
+
+	int channels = 0;
+	for (int k = 0; k < BUDDHABROT_CHANNELS; k++)
+		if (iteration <= m_Settings.maxIterations[k]) orbit.channels |= 1 << k, channels++;
+	orbit.contribution = (float)(orbit.pixels.size() * channels);
+}
+
+void Buddhabrot::Accumulate(const Orbit& orbit, float weight, float* histogram) const {
+	const size_t plane = (size_t)m_Width * m_Height;
+	for (int k = 0; k < BUDDHABROT_CHANNELS; k++) {
+		if (!(orbit.channels & (1 << k))) continue;
+		float* channel = histogram + k * plane;
+		for (uint p : orbit.pixels) channel[p] += weight;
+	}
+}
+
+void Buddhabrot::Step() {
+	TRACE_SCOPE("cpu", "buddhabrot");
+	const size_t planes = (size_t)BUDDHABROT_CHANNELS * m_Width * m_Height;
+	const double pixelSize = 2.0 * m_View.zoom / m_Width;
+	unsigned long long contributing = 0, accepted = 0;
+
+#pragma omp parallel num_threads((int)m_Threads.size()) reduction(+ : contributing, accepted)
+	{
+		ThreadState& state = m_Threads[omp_get_thread_num()];
+		float* histogram = &m_ThreadHistograms[omp_get_thread_num() * planes];
+		std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+#pragma omp for schedule(static)
+		for (int s = 0; s < m_Settings.samplesPerStep; s++) {
+			Orbit& current = state.current;
+			Orbit& proposal = state.proposal;
+
+			// Without a contributing orbit there is nothing to mutate, start over anywhere.
+			bool large = !m_Settings.metropolis || current.contribution == 0.0f || uniform(state.rng) < m_Settings.largeMutation;
+			if (large) TraceOrbit(uniform(state.rng) * 4.0 - 2.0, uniform(state.rng) * 4.0 - 2.0, proposal);
+			else {
+				// Mutations between half a pixel and 50 pixels of the view, uniform in log scale.
+				double radius = pixelSize * 0.5 * std::exp(uniform(state.rng) * std::log(100.0));
+				double angle = uniform(state.rng) * 6.283185307179586;
+				TraceOrbit(current.cx + radius * std::cos(angle), current.cy + radius * std::sin(angle), proposal);
+			}
+			contributing += proposal.contribution > 0.0f;
+
+			if (!m_Settings.metropolis) {
+				if (proposal.contribution > 0.0f) Accumulate(proposal, 1.0f, histogram);
+				continue;
+			}
+
+			// Both proposals are symmetric, the acceptance probability is the ratio of contributions. Both the proposal and
+			// the current orbit are accumulated weighted by their probability of being the next state, divided by the
+			// contribution the chain samples them proportionally to.
+			float acceptance = current.contribution > 0.0f ? std::min(1.0f, proposal.contribution / current.contribution) : (proposal.contribution > 0.0f ? 1.0f : 0.0f);
+			if (proposal.contribution > 0.0f) Accumulate(proposal, acceptance / proposal.contribution, histogram);
+			if (current.contribution > 0.0f && acceptance < 1.0f) Accumulate(current, (1.0f - acceptance) / current.contribution, histogram);
+			if (uniform(state.rng) < acceptance) {
+				std::swap(current, proposal);
+				accepted++;
+			}
+		}
+
+		// Periodic reduction: every thread sums a range of the histogram entries over all threads, no atomics needed.
+		TRACE_SCOPE("cpu", "buddhabrot reduce");
+		const int threads = (int)m_Threads.size();
+#pragma omp for schedule(static)
+		for (long long p = 0; p < (long long)planes; p++) {
+			double sum = 0.0;
+			for (int t = 0; t < threads; t++) {
+				float& value = m_ThreadHistograms[t * planes + p];
+				sum += value;
+				value = 0.0f;
+			}
+			m_Histogram[p] += sum;
+		}
+	}
+
+	m_Stats.samples += m_Settings.samplesPerStep;
+	m_Stats.contributing += contributing;
+	m_Stats.accepted += accepted;
+}
+
+void Buddhabrot::Resolve(Color* colors, float gamma) const {
+	const size_t plane = (size_t)m_Width * m_Height;
+	double scale[BUDDHABROT_CHANNELS];
+	for (int k = 0; k < BUDDHABROT_CHANNELS; k++) {
+		double maximum = *std::max_element(m_Histogram.begin() + k * plane, m_Histogram.begin() + (k + 1) * plane);
+		scale[k] = maximum > 0.0 ? 1.0 / maximum : 0.0;
+	}
+
+#pragma omp parallel for
+	for (long long p = 0; p < (long long)plane; p++) {
+		float r = std::pow((float)(m_Histogram[p] * scale[0]), gamma);
+		float g = std::pow((float)(m_Histogram[plane + p] * scale[1]), gamma);
+		float b = std::pow((float)(m_Histogram[2 * plane + p] * scale[2]), gamma);
+		colors[p] = Color(r, g, b);
+	}
+}
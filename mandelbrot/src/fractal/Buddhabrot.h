@@ -0,0 +1,84 @@
+#pragma once
+#include "Mandelbrot.h"
+#include <random>
+
+/* Color channels of the density histogram, each with its own iteration limit for the Nebulabrot. */
+#define BUDDHABROT_CHANNELS 3
+
+/* Settings of the Buddhabrot renderer, changing them requires a Reset. */
+struct BuddhabrotSettings {
+	/* Iteration limit of the red, green and blue channel. An orbit counts in every channel whose limit it escaped within,
+	* equal limits give the gray Buddhabrot. */
+	int maxIterations[BUDDHABROT_CHANNELS] = { 1000, 200, 50 };
+	/* Number of sampled c values per Step, spread over all threads. */
+	int samplesPerStep = 100000;
+	/* Sample c with Metropolis-Hastings proportional to the number of orbit points that land in the view, instead of uniformly. */
+	bool metropolis = true;
+	/* Probability of proposing a uniformly random c instead of a small mutation of the current one. */
+	float largeMutation = 0.1f;
+};
+
+/* Statistics since the last Reset. */
+struct BuddhabrotStats {
+	/* Sampled c values, the ones whose orbit escaped into the view and accepted Metropolis-Hastings proposals. */
+	unsigned long long samples = 0, contributing = 0, accepted = 0;
+};
+
+/** Progressive Buddhabrot and Nebulabrot renderer: the orbits of escaping points are accumulated into a density histogram
+* of the view. Every thread accumulates into its own histogram, they are summed into the total in parallel after every Step.
+*/
+class Buddhabrot {
+
+public:
+	/** Reserves the histograms.
+	* @param[in] width				Image width.
+	* @param[in] height				Image height.
+	*/
+	Buddhabrot(uint width, uint height);
+
+	/** Clears the histograms and starts accumulating a new image.
+	* @param[in] view				Region of the complex plane the orbits are accumulated in.
+	* @param[in] settings			Iteration limits and sampling.
+	*/
+	void Reset(const View& view, const BuddhabrotSettings& settings);
+	/** Samples settings.samplesPerStep c values and adds their orbits to the total histogram. */
+	void Step();
+	/** Tone maps the histogram of every channel normalized by its maximum density, can be called after every Step.
+	* @param[out] colors			Color per pixel.
+	* @param[in] gamma				Exponent applied to the normalized densities.
+	*/
+	void Resolve(Color* colors, float gamma = 0.5f) const;
+
+	const BuddhabrotSettings& GetSettings() const { return m_Settings; }
+	const BuddhabrotStats& GetStats() const { return m_Stats; }
+
+private:
+	/* Points of an orbit that lie in the view, as pixel indices. */
+	struct Orbit {
+		double cx = 0.0, cy = 0.0;
+		std::vector<uint> pixels;
+		/* Bit per channel the orbit counts in. */
+		uint channels = 0;
+		/* Number of histogram entries the orbit adds, the target density of Metropolis-Hastings. */
+		float contribution = 0.0f;
+	};
+	/* Markov chain and random numbers of a thread. */
+	struct ThreadState {
+		std::mt19937 rng;
+		Orbit current, proposal;
+	};
+
+	uint m_Width, m_Height;
+	View m_View;
+	BuddhabrotSettings m_Settings;
+	BuddhabrotStats m_Stats;
+	/* Histogram per thread, BUDDHABROT_CHANNELS planes of m_Width * m_Height, emptied into m_Histogram after every Step. */
+	std::vector<float> m_ThreadHistograms;
+	std::vector<double> m_Histogram;
+	std::vector<ThreadState> m_Threads;
+
+	/** Iterates c and keeps the orbit points in the view if it escapes within the largest iteration limit. */
+	void TraceOrbit(double cx, double cy, Orbit& orbit) const;
+	/** Adds the points of an orbit to a histogram in all its channels. */
+	void Accumulate(const Orbit& orbit, float weight, float* histogram) const;
+};
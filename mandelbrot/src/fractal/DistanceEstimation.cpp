@@ -0,0 +1,83 @@
+#include "DistanceEstimation.h"
+#include "FastMath.h"
+#include "tmpl/Trace.h"
+#include <algorithm>
+#include <cmath>
+
+void ComputeDistanceTile(const View& view, uint width, uint height, int maxIterations, uint x0, uint y0, uint x1, uint y1,
+	int* iterations, float* distance, float* smooth) {
+	// A large bailout radius makes the estimate accurate.
+	const double bailout = SMOOTH_BAILOUT;
+	// ln 2 / 4 turns log2|z|^2 * |z| / |dz| into |z| ln|z| / |dz| / 2, the rest converts it to pixels.
+	const float scale = 0.1732868f * (float)width / (float)(2.0 * view.zoom);
+	// |z|^2 and |z| / |dz| at escape of a run of at most TILE_SIZE pixels.
+	float escapeRadius[TILE_SIZE], ratio[TILE_SIZE];
+
+	for (uint y = y0; y < y1; y++)
+		for (uint xs = x0; xs < x1; xs += TILE_SIZE) {
+			uint xe = xs + TILE_SIZE < x1 ? xs + TILE_SIZE : x1;
+
+			for (uint x = xs; x < xe; x++) {
+				double cx = view.centerX + ((double)x / (double)width - 0.5) * 2.0 * view.zoom;
+				double cy = view.centerY + ((double)y / (double)height - 0.5) * 2.0 * view.zoom;
+
+				double xi = 0.0, yi = 0.0;
+				double xx = 0.0, yy = 0.0;
+				// dz/dc, z' = 2 z z' + 1.
+				double dx = 0.0, dy = 0.0;
+				int iteration = 0;
+
+				while (xx + yy <= bailout && iteration < maxIterations) {
+					double ndx = 2.0 * (xi * dx - yi * dy) + 1.0;
+					dy = 2.0 * (xi * dy + yi * dx);
+					dx = ndx;
+					yi = 2.0 * xi * yi + cy;
+					xi = xx - yy + cx;
+					xx = xi * xi;
+					yy = yi * yi;
+					iteration++;
+				}
+
+				iterations[x + y * width] = iteration >= maxIterations ? -1 : iteration;
+				escapeRadius[x - xs] = (float)(xx + yy);
+				// In double, |dz| overflows a float long before |z| escapes near the boundary.
+				ratio[x - xs] = (float)std::sqrt((xx + yy) / (dx * dx + dy * dy));
+			}
+
+			// Separate passes over the run so the logarithms run on eight pixels at a time.
+			const int* runIterations = iterations + xs + y * width;
+			float* runDistance = distance + xs + y * width;
+			int count = (int)(xe - xs), i = 0;
+#ifdef __AVX2__
+			for (; i + 8 <= count; i += 8) {
+				__m256i iteration = _mm256_loadu_si256((const __m256i*)(runIterations + i));
+				__m256 d = _mm256_mul_ps(_mm256_mul_ps(FastLog2(_mm256_loadu_ps(escapeRadius + i)), _mm256_loadu_ps(ratio + i)), _mm256_set1_ps(scale));
+				__m256 inside = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_setzero_si256(), iteration));
+				_mm256_storeu_ps(runDistance + i, _mm256_blendv_ps(d, _mm256_set1_ps(-1.0f), inside));
+			}
+#endif
+			for (; i < count; i++) {
+				float d = FastLog2(escapeRadius[i]) * ratio[i] * scale;
+				runDistance[i] = runIterations[i] < 0 ? -1.0f : d;
+			}
+			if (smooth) SmoothIterations(runIterations, escapeRadius, count, 1.0f, smooth + xs + y * width);
+		}
+}
+
+void ComputeDistances(const View& view, uint width, uint height, int maxIterations, int* iterations, float* distance, float* smooth) {
+	ForEachTile(width, height, [&](int, uint x0, uint y0, uint x1, uint y1) {
+		ComputeDistanceTile(view, width, height, maxIterations, x0, y0, x1, y1, iterations, distance, smooth);
+	});
+}
+
+void ShadeDistance(const float* distance, size_t pixels, float thickness, Color* colors) {
+	const float invThickness = 1.0f / std::max(thickness, 1e-3f);
+#pragma omp parallel for
+	for (long long p = 0; p < (long long)pixels; p++) {
+		if (distance[p] < 0.0f) continue;
+		// Square root so the falloff is sharp at the boundary and filaments stay visible.
+		float t = std::sqrt(std::min(distance[p] * invThickness, 1.0f));
+		Color& c = colors[p];
+		c = Color(c.r * t, c.g * t, c.b * t);
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "Mandelbrot.h"
+
+/** Computes the iterations and exterior distance estimates of a rectangular part of the image on the calling thread.
+* The derivative dz/dc is iterated alongside z, the distance to the set is about |z| ln|z| / |dz| at escape.
+* @param[in] view				Region of the complex plane.
+* @param[in] width				Image width.
+* @param[in] height				Image height.
+* @param[in] maxIterations		Maximum number of iterations.
+* @param[in] x0, y0				Top-left pixel of the tile (inclusive).
+* @param[in] x1, y1				Bottom-right pixel of the tile (exclusive).
+* @param[out] iterations		Iteration count per pixel of the image, -1 inside the set. Of size width * height.
+* @param[out] distance			Estimated distance to the set per pixel in pixels, -1 inside the set. Of size width * height.
+* @param[out] smooth			Optional continuous iteration count per pixel, -1 inside the set.
+*/
+void ComputeDistanceTile(const View& view, uint width, uint height, int maxIterations, uint x0, uint y0, uint x1, uint y1,
+	int* iterations, float* distance, float* smooth = nullptr);
+
+/** Computes the iterations and exterior distance estimates of the whole image, tiles are distributed over all threads.
+* @param[in] view				Region of the complex plane.
+* @param[in] width				Image width.
+* @param[in] height				Image height.
+* @param[in] maxIterations		Maximum number of iterations.
+* @param[out] iterations		Iteration count per pixel, -1 inside the set. Of size width * height.
+* @param[out] distance			Estimated distance to the set per pixel in pixels, -1 inside the set. Of size width * height.
+* @param[out] smooth			Optional continuous iteration count per pixel, -1 inside the set.
+*/
+void ComputeDistances(const View& view, uint width, uint height, int maxIterations, int* iterations, float* distance, float* smooth = nullptr);
+
+/** Darkens the colors towards the boundary of the set, drawing its filaments and outline.
+* @param[in] distance			Estimated distance to the set per pixel in pixels, -1 inside the set.
+* @param[in] pixels				Number of pixels.
+* @param[in] thickness			Distance in pixels below which a pixel is darkened, fully on the boundary.
+* @param[in,out] colors			Colors to darken.
+*/
+void ShadeDistance(const float* distance, size_t pixels, float thickness, Color* colors);
@@ -0,0 +1,11 @@
+#include "FastMath.h"
+#include <cmath>
+
+/** Fills the mantissa table of FastLog2. */
+static float* CreateLog2Table() {
+	static float table[LOG2_TABLE_SIZE + 1];
+	for (int i = 0; i <= LOG2_TABLE_SIZE; i++) table[i] = (float)std::log2(1.0 + (double)i / LOG2_TABLE_SIZE);
+	return table;
+}
+
+const float* const log2Table = CreateLog2Table();
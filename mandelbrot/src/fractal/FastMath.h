@@ -0,0 +1,80 @@
+#pragma once
+#include <cstring>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/* Number of intervals of the mantissa table, a power of two. */
+#define LOG2_TABLE_BITS 8
+#define LOG2_TABLE_SIZE (1 << LOG2_TABLE_BITS)
+
+/* log2 of 1 + i / LOG2_TABLE_SIZE for i in [0, LOG2_TABLE_SIZE], the last entry for interpolating. */
+extern const float* const log2Table;
+
+/** Fast log2 of a positive, normal float: the exponent bits give the integer part, the table interpolated on the
+* leading mantissa bits the fraction. Absolute error below 1e-5, branch-free so it vectorizes as a gather.
+*/
+inline float FastLog2(float x) {
+	unsigned int bits;
+	memcpy(&bits, &x, sizeof(bits));
+	int exponent = (int)((bits >> 23) & 255) - 127;
+	unsigned int mantissa = bits & 0x7fffff;
+
+	unsigned int index = mantissa >> (23 - LOG2_TABLE_BITS);
+	float t = (float)(mantissa & ((1 << (23 - LOG2_TABLE_BITS)) - 1)) * (1.0f / (1 << (23 - LOG2_TABLE_BITS)));
+	return (float)exponent + log2Table[index] + (log2Table[index + 1] - log2Table[index]) * t;
+}
+
+#ifdef __AVX2__
+/** FastLog2 of eight floats, the table entries are gathered. */
+inline __m256 FastLog2(__m256 x) {
+	const __m256i bits = _mm256_castps_si256(x);
+	__m256i exponent = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_and_si256(bits, _mm256_set1_epi32(0x7f800000)), 23), _mm256_set1_epi32(127));
+	__m256i mantissa = _mm256_and_si256(bits, _mm256_set1_epi32(0x7fffff));
+
+	__m256i index = _mm256_srli_epi32(mantissa, 23 - LOG2_TABLE_BITS);
+	__m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(mantissa, _mm256_set1_epi32((1 << (23 - LOG2_TABLE_BITS)) - 1))),
+		_mm256_set1_ps(1.0f / (1 << (23 - LOG2_TABLE_BITS))));
+	__m256 a = _mm256_i32gather_ps(log2Table, index, 4), b = _mm256_i32gather_ps(log2Table + 1, index, 4);
+	return _mm256_add_ps(_mm256_add_ps(_mm256_cvtepi32_ps(exponent), a), _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+}
+#endif
+
+/* Squared bailout radius for continuous iteration counts. A large radius makes the count independent of where the orbit crosses it. */
+#define SMOOTH_BAILOUT (256.0 * 256.0)
+
+/** Continuous iteration count of an escaped pixel, in (iteration - 1, iteration].
+* @param[in] iteration			Iteration at which |z|^2 first exceeded SMOOTH_BAILOUT.
+* @param[in] r2					|z|^2 at that iteration.
+*/
+inline float SmoothIteration(int iteration, float r2) {
+	// log|z| / log(bailout radius) lies in [1, 2), its log2 is the fraction of the last iteration that was not needed.
+	const float invLogBailout = 1.0f / 16.0f; // 1 / log2(SMOOTH_BAILOUT)
+	return (float)iteration - FastLog2(FastLog2(r2) * invLogBailout);
+}
+
+/** Continuous iteration counts of a run of pixels, eight at a time with AVX2 and a scalar tail.
+* @param[in] iterations			Iteration count per pixel, -1 inside the set.
+* @param[in] r2					|z|^2 per pixel at the iteration it escaped, ignored inside the set.
+* @param[in] count				Number of pixels.
+* @param[in] fractionScale		Factor of the fraction of the last iteration, 1 / log2 of the degree of the formula.
+* @param[out] smooth			Continuous iteration count per pixel, -1 inside the set.
+*/
+inline void SmoothIterations(const int* iterations, const float* r2, int count, float fractionScale, float* smooth) {
+	const float invLogBailout = 1.0f / 16.0f; // 1 / log2(SMOOTH_BAILOUT)
+	int i = 0;
+#ifdef __AVX2__
+	for (; i + 8 <= count; i += 8) {
+		__m256i iteration = _mm256_loadu_si256((const __m256i*)(iterations + i));
+		// The table indices come from the mantissa bits, any r2 of an interior pixel stays within the table.
+		__m256 fraction = FastLog2(_mm256_mul_ps(FastLog2(_mm256_loadu_ps(r2 + i)), _mm256_set1_ps(invLogBailout)));
+		__m256 s = _mm256_sub_ps(_mm256_cvtepi32_ps(iteration), _mm256_mul_ps(fraction, _mm256_set1_ps(fractionScale)));
+		__m256 inside = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_setzero_si256(), iteration));
+		_mm256_storeu_ps(smooth + i, _mm256_blendv_ps(s, _mm256_set1_ps(-1.0f), inside));
+	}
+#endif
+	for (; i < count; i++) {
+		float s = (float)iterations[i] - FastLog2(FastLog2(r2[i]) * invLogBailout) * fractionScale;
+		smooth[i] = iterations[i] < 0 ? -1.0f : s;
+	}
+}
@@ -0,0 +1,79 @@
+#include "Formula.h"
+#include "FastMath.h"
+#include "tmpl/Trace.h"
+
+/** Computes the iterations of a rectangular part of the image with one formula, four pixels at a time with AVX2. */
+template <typename Formula, bool Julia> static void ComputeFormulaTile(const View& view, uint width, uint height, int maxIterations,
+	const FormulaParams& params, uint x0, uint y0, uint x1, uint y1, int* iterations, float* smooth) {
+	const double bailout = smooth ? SMOOTH_BAILOUT : 4.0;
+	// |z|^2 at escape of a run of at most TILE_SIZE pixels.
+	float escapeRadius[TILE_SIZE];
+
+	for (uint y = y0; y < y1; y++)
+		for (uint xs = x0; xs < x1; xs += TILE_SIZE) {
+			uint xe = xs + TILE_SIZE < x1 ? xs + TILE_SIZE : x1;
+			double py = view.centerY + ((double)y / (double)height - 0.5) * 2.0 * view.zoom;
+			uint x = xs;
+
+#ifdef __AVX2__
+			for (; x + 4 <= xe; x += 4) {
+				double4 px = _mm256_setr_pd(
+					view.centerX + ((double)(x + 0) / (double)width - 0.5) * 2.0 * view.zoom,
+					view.centerX + ((double)(x + 1) / (double)width - 0.5) * 2.0 * view.zoom,
+					view.centerX + ((double)(x + 2) / (double)width - 0.5) * 2.0 * view.zoom,
+					view.centerX + ((double)(x + 3) / (double)width - 0.5) * 2.0 * view.zoom);
+				double4 cx = Julia ? double4(params.juliaC[0]) : px, cy = Julia ? double4(params.juliaC[1]) : double4(py);
+				double4 zx = Julia ? px : double4(0.0), zy = Julia ? double4(py) : double4(0.0);
+
+				int counts[4];
+				float radii[4];
+				IterateLanes<Formula>(zx, zy, cx, cy, maxIterations, bailout, counts, radii);
+				for (int lane = 0; lane < 4; lane++) {
+					iterations[x + lane + y * width] = counts[lane];
+					escapeRadius[x + lane - xs] = radii[lane];
+				}
+			}
+#endif
+			for (; x < xe; x++) {
+				double px = view.centerX + ((double)x / (double)width - 0.5) * 2.0 * view.zoom;
+				double cx = Julia ? params.juliaC[0] : px, cy = Julia ? params.juliaC[1] : py;
+				double zx = Julia ? px : 0.0, zy = Julia ? py : 0.0;
+				iterations[x + y * width] = IterateFormula<Formula>(zx, zy, cx, cy, maxIterations, bailout, escapeRadius[x - xs]);
+			}
+
+			// Separate pass over the run so the logarithms run on eight pixels at a time. The fraction of the last iteration
+			// is a logarithm to the base of the degree.
+			if (smooth)
+				SmoothIterations(iterations + xs + y * width, escapeRadius, (int)(xe - xs), Formula::Power == 2 ? 1.0f : 1.0f / std::log2((float)Formula::Power),
+					smooth + xs + y * width);
+		}
+}
+
+typedef void (*FormulaTileFunction)(const View&, uint, uint, int, const FormulaParams&, uint, uint, uint, uint, int*, float*);
+
+template <typename Formula> static FormulaTileFunction SelectTileFunction(bool julia) {
+	return julia ? ComputeFormulaTile<Formula, true> : ComputeFormulaTile<Formula, false>;
+}
+
+static FormulaTileFunction GetTileFunction(const FormulaParams& params) {
+	switch (params.type) {
+	case FormulaType::BurningShip: return SelectTileFunction<BurningShipFormula>(params.julia);
+	case FormulaType::Tricorn: return SelectTileFunction<TricornFormula>(params.julia);
+	case FormulaType::Multibrot3: return SelectTileFunction<MultibrotFormula<3>>(params.julia);
+	case FormulaType::Multibrot4: return SelectTileFunction<MultibrotFormula<4>>(params.julia);
+	case FormulaType::Multibrot5: return SelectTileFunction<MultibrotFormula<5>>(params.julia);
+	default: return SelectTileFunction<MandelbrotFormula>(params.julia);
+	}
+}
+
+void ComputeFormula(const View& view, uint width, uint height, int maxIterations, const FormulaParams& params, int* iterations, float* smooth) {
+	FormulaTileFunction computeTile = GetTileFunction(params);
+	ForEachTile(width, height, [&](int, uint x0, uint y0, uint x1, uint y1) {
+		computeTile(view, width, height, maxIterations, params, x0, y0, x1, y1, iterations, smooth);
+	});
+}
+
+const char* GetFormulaName(FormulaType type) {
+	static const char* names[] = { "Mandelbrot", "Burning Ship", "Tricorn", "Multibrot 3", "Multibrot 4", "Multibrot 5" };
+	return type < FormulaType::Count ? names[(int)type] : "unknown";
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include "Mandelbrot.h"
+#include <cmath>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/* Escape-time formulas the engine is instantiated for. */
+enum class FormulaType : int {
+	Mandelbrot = 0,
+	BurningShip,
+	Tricorn,
+	Multibrot3,
+	Multibrot4,
+	Multibrot5,
+	Count
+};
+
+/* Formula and its parameters, chosen at runtime. */
+struct FormulaParams {
+	FormulaType type = FormulaType::Mandelbrot;
+	/* Iterate the Julia set of the constant instead: z starts at the pixel and c is fixed. */
+	bool julia = false;
+	double juliaC[2] = { -0.8, 0.156 };
+};
+
+inline double Abs(double x) {
+	return std::fabs(x);
+}
+
+#ifdef __AVX2__
+/* Four doubles in an AVX register with the operators the formulas use, so one formula serves both scalar and vector code. */
+struct double4 {
+	__m256d v;
+	double4() : v(_mm256_setzero_pd()) {}
+	double4(__m256d v) : v(v) {}
+	double4(double s) : v(_mm256_set1_pd(s)) {}
+};
+inline double4 operator+(double4 a, double4 b) { return _mm256_add_pd(a.v, b.v); }
+inline double4 operator-(double4 a, double4 b) { return _mm256_sub_pd(a.v, b.v); }
+inline double4 operator*(double4 a, double4 b) { return _mm256_mul_pd(a.v, b.v); }
+inline double4 operator/(double4 a, double4 b) { return _mm256_div_pd(a.v, b.v); }
+inline double4 Abs(double4 a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v); }
+#endif
+
+/*
+* Formula policies. Step advances z = x + yi by one iteration given xx = x * x and yy = y * y, and updates xx and yy for
+* the bailout test. T is double or double4. Power is the degree of the formula, it scales the continuous iteration count.
+*/
+
+/* z = z^2 + c */
+struct MandelbrotFormula {
+	static const int Power = 2;
+	template <typename T> static inline void Step(T& x, T& y, T& xx, T& yy, const T& cx, const T& cy) {
+		y = T(2.0) * x * y + cy;
+		x = xx - yy + cx;
+		xx = x * x;
+		yy = y * y;
+	}
+};
+
+/* z = (|Re z| + |Im z| i)^2 + c */
+struct BurningShipFormula {
+	static const int Power = 2;
+	template <typename T> static inline void Step(T& x, T& y, T& xx, T& yy, const T& cx, const T& cy) {
+		y = T(2.0) * Abs(x * y) + cy;
+		x = xx - yy + cx;
+		xx = x * x;
+		yy = y * y;
+	}
+};
+
+/* z = conj(z)^2 + c */
+struct TricornFormula {
+	static const int Power = 2;
+	template <typename T> static inline void Step(T& x, T& y, T& xx, T& yy, const T& cx, const T& cy) {
+		y = T(-2.0) * x * y + cy;
+		x = xx - yy + cx;
+		xx = x * x;
+		yy = y * y;
+	}
+};
+
+/* z = z^N + c, the power is unrolled at compile time. */
+template <int N> struct MultibrotFormula {
+	static const int Power = N;
+	template <typename T> static inline void Step(T& x, T& y, T& xx, T& yy, const T& cx, const T& cy) {
+		T zx = x, zy = y;
+		for (int k = 1; k < N; k++) {
+			T t = zx * x - zy * y;
+			zy = zx * y + zy * x;
+			zx = t;
+		}
+		x = zx + cx;
+		y = zy + cy;
+		xx = x * x;
+		yy = y * y;
+	}
+};
+
+/** Iterates a single point with a formula.
+* @param[in] zx, zy				Starting value of z.
+* @param[in] cx, cy				Constant c.
+* @param[in] maxIterations		Maximum number of iterations.
+* @param[in] bailout			Squared bailout radius.
+* @param[out] r2				|z|^2 at escape.
+* @returns						Iteration count, -1 inside the set.
+*/
+template <typename Formula> inline int IterateFormula(double zx, double zy, double cx, double cy, int maxIterations, double bailout, float& r2) {
+	double xx = zx * zx, yy = zy * zy;
+	int iteration = 0;
+
+	while (xx + yy <= bailout && iteration < maxIterations) {
+		Formula::Step(zx, zy, xx, yy, cx, cy);
+		iteration++;
+	}
+
+	r2 = (float)(xx + yy);
+	return iteration >= maxIterations ? -1 : iteration;
+}
+
+#ifdef __AVX2__
+/** Iterates four points with a formula, one per lane. Lanes keep iterating after they escaped until all have, their
+* count and escape radius are frozen by a mask. Gives the same results as IterateFormula per lane.
+* @param[in] zx, zy				Starting values of z.
+* @param[in] cx, cy				Constants c.
+* @param[in] maxIterations		Maximum number of iterations.
+* @param[in] bailout			Squared bailout radius.
+* @param[out] counts			Iteration count per lane, -1 inside the set.
+* @param[out] r2				|z|^2 at escape per lane.
+*/
+template <typename Formula> inline void IterateLanes(double4 zx, double4 zy, double4 cx, double4 cy, int maxIterations, double bailout,
+	int counts[4], float r2[4]) {
+	double4 xx = zx * zx, yy = zy * zy;
+	const __m256d limit = _mm256_set1_pd(bailout), one = _mm256_set1_pd(1.0);
+	__m256d active = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+	__m256d count = _mm256_setzero_pd(), escape = _mm256_setzero_pd();
+	for (int iteration = 0; iteration < maxIterations; iteration++) {
+		__m256d radius = _mm256_add_pd(xx.v, yy.v);
+		__m256d inside = _mm256_cmp_pd(radius, limit, _CMP_LE_OQ);
+		escape = _mm256_blendv_pd(escape, radius, _mm256_andnot_pd(inside, active));
+		active = _mm256_and_pd(active, inside);
+		if (_mm256_movemask_pd(active) == 0) break;
+
+		Formula::Step(zx, zy, xx, yy, cx, cy);
+		count = _mm256_add_pd(count, _mm256_and_pd(active, one));
+	}
+
+	double radii[4];
+	_mm_storeu_si128((__m128i*)counts, _mm256_cvtpd_epi32(count));
+	_mm256_storeu_pd(radii, escape);
+	for (int lane = 0; lane < 4; lane++) {
+		if (counts[lane] >= maxIterations) counts[lane] = -1;
+		r2[lane] = (float)radii[lane];
+	}
+}
+#endif
+
+/** Computes the iterations of the whole image with a formula, tiles are distributed over all threads. The formula is
+* selected once per call, every formula and Julia variant has its own specialized and vectorized tile loop.
+* The Mandelbrot formula gives the same results as ComputeIterations.
+* @param[in] view				Region of the complex plane.
+* @param[in] width				Image width.
+* @param[in] height				Image height.
+* @param[in] maxIterations		Maximum number of iterations.
+* @param[in] params				Formula and Julia constant.
+* @param[out] iterations		Iteration count per pixel, -1 inside the set. Of size width * height.
+* @param[out] smooth			Optional continuous iteration count per pixel, -1 inside the set. Computing it raises the bailout radius.
+*/
+void ComputeFormula(const View& view, uint width, uint height, int maxIterations, const FormulaParams& params, int* iterations, float* smooth = nullptr);
+
+/** Display name of a formula. */
+const char* GetFormulaName(FormulaType type);
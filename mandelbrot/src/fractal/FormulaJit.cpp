@@ -0,0 +1,570 @@
+#include "FormulaJit.h"
+#include "tmpl/Trace.h"
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#include <Windows.h>
+#else
+#include <dlfcn.h>
+#include <sys/stat.h>
+#endif
+
+/* Largest integer power, powers are expanded into multiplications. */
+#define JIT_MAX_POWER 64
+
+/* Operand of the generated code, either a constant or a named variable. */
+struct JitOperand {
+	std::string name;
+	double constant = 0.0;
+
+	bool IsConstant() const { return name.empty(); }
+	bool Is(double value) const { return IsConstant() && constant == value; }
+	/** Expression of the operand in the generated code. */
+	std::string GetCode() const {
+		if (!IsConstant()) return name;
+		char code[40];
+		snprintf(code, sizeof(code), "SET(%.17g)", constant);
+		return code;
+	}
+};
+
+static JitOperand JitConstant(double value) {
+	JitOperand operand;
+	operand.constant = value;
+	return operand;
+}
+
+static JitOperand JitVariable(const char* name) {
+	JitOperand operand;
+	operand.name = name;
+	return operand;
+}
+
+/* Complex value as its real and imaginary operand. */
+struct JitComplex {
+	JitOperand re, im;
+};
+
+/** Emits the real operations of a formula as assignments to temporaries. Operations on constants are folded and
+* repeated operations reuse the temporary of their first occurrence.
+*/
+class JitEmitter {
+
+public:
+	/** Lines emitted so far, each assigns one temporary. */
+	const std::vector<std::string>& GetLines() const { return m_Lines; }
+	/** Set if a folded constant is not finite, e.g. a division by zero. */
+	bool HasInvalidConstant() const { return m_InvalidConstant; }
+
+	JitOperand Add(const JitOperand& a, const JitOperand& b) {
+		if (a.IsConstant() && b.IsConstant()) return Fold(a.constant + b.constant);
+		if (a.Is(0.0)) return b;
+		if (b.Is(0.0)) return a;
+		return Emit("ADD", a, b, true);
+	}
+
+	JitOperand Sub(const JitOperand& a, const JitOperand& b) {
+		if (a.IsConstant() && b.IsConstant()) return Fold(a.constant - b.constant);
+		if (a.Is(0.0)) return Neg(b);
+		if (b.Is(0.0)) return a;
+		return Emit("SUB", a, b, false);
+	}
+
+	JitOperand Mul(const JitOperand& a, const JitOperand& b) {
+		if (a.IsConstant() && b.IsConstant()) return Fold(a.constant * b.constant);
+		if (a.Is(0.0) || b.Is(0.0)) return JitConstant(0.0);
+		if (a.Is(1.0)) return b;
+		if (b.Is(1.0)) return a;
+		if (a.Is(-1.0)) return Neg(b);
+		if (b.Is(-1.0)) return Neg(a);
+		return Emit("MUL", a, b, true);
+	}
+
+	JitOperand Div(const JitOperand& a, const JitOperand& b) {
+		if (a.IsConstant() && b.IsConstant()) return Fold(a.constant / b.constant);
+		if (a.Is(0.0)) return JitConstant(0.0);
+		if (b.Is(1.0)) return a;
+		return Emit("DIV", a, b, false);
+	}
+
+	JitOperand Neg(const JitOperand& a) {
+		if (a.IsConstant()) return Fold(-a.constant);
+		return Emit("NEG", a);
+	}
+
+	JitOperand Abs(const JitOperand& a) {
+		if (a.IsConstant()) return Fold(std::fabs(a.constant));
+		return Emit("ABS", a);
+	}
+
+	JitComplex Add(const JitComplex& a, const JitComplex& b) { return { Add(a.re, b.re), Add(a.im, b.im) }; }
+	JitComplex Sub(const JitComplex& a, const JitComplex& b) { return { Sub(a.re, b.re), Sub(a.im, b.im) }; }
+
+	JitComplex Mul(const JitComplex& a, const JitComplex& b) {
+		// A square needs three multiplications, the same as the hard-coded formulas.
+		if (a.re.GetCode() == b.re.GetCode() && a.im.GetCode() == b.im.GetCode()) {
+			JitOperand product = Mul(a.re, a.im);
+			return { Sub(Mul(a.re, a.re), Mul(a.im, a.im)), Add(product, product) };
+		}
+		return { Sub(Mul(a.re, b.re), Mul(a.im, b.im)), Add(Mul(a.re, b.im), Mul(a.im, b.re)) };
+	}
+
+	JitComplex Div(const JitComplex& a, const JitComplex& b) {
+		JitOperand norm = Add(Mul(b.re, b.re), Mul(b.im, b.im));
+		return { Div(Add(Mul(a.re, b.re), Mul(a.im, b.im)), norm), Div(Sub(Mul(a.im, b.re), Mul(a.re, b.im)), norm) };
+	}
+
+	/** Raises to an integer power by repeated squaring. */
+	JitComplex Pow(JitComplex a, int power) {
+		JitComplex result = { JitConstant(1.0), JitConstant(0.0) };
+		for (; power > 0; power >>= 1) {
+			if (power & 1) result = Mul(result, a);
+			if (power > 1) a = Mul(a, a);
+		}
+		return result;
+	}
+
+private:
+	std::vector<std::string> m_Lines;
+	/** Temporary of every emitted operation, by its expression. */
+	std::map<std::string, std::string> m_Temporaries;
+	bool m_InvalidConstant = false;
+
+	JitOperand Fold(double value) {
+		if (!std::isfinite(value)) m_InvalidConstant = true, value = 0.0;
+		return JitConstant(value);
+	}
+
+	JitOperand Emit(const char* op, const JitOperand& a) {
+		return Emit(std::string(op) + "(" + a.GetCode() + ")");
+	}
+
+	JitOperand Emit(const char* op, const JitOperand& a, const JitOperand& b, bool commutative) {
+		std::string first = a.GetCode(), second = b.GetCode();
+		if (commutative && second < first) std::swap(first, second);
+		return Emit(std::string(op) + "(" + first + ", " + second + ")");
+	}
+
+	JitOperand Emit(const std::string& expression) {
+		auto temporary = m_Temporaries.find(expression);
+		if (temporary != m_Temporaries.end()) return JitVariable(temporary->second.c_str());
+
+		std::string name = "t" + std::to_string(m_Lines.size());
+		m_Lines.push_back("T " + name + " = " + expression + ";");
+		m_Temporaries[expression] = name;
+		return JitVariable(name.c_str());
+	}
+};
+
+/** Recursive descent parser of the formula language, emits the operations while parsing.
+*	expression	= term { ("+" | "-") term }
+*	term		= unary { ["*" | "/"] unary }, without an operator it multiplies
+*	unary		= ("-" | "+") unary | power
+*	power		= primary [ "^" integer ]
+*	primary		= number | "z" | "c" | "i" | function "(" expression ")" | "(" expression ")"
+*/
+class JitParser {
+
+public:
+	JitParser(const char* text, JitEmitter& emitter, const JitComplex& z, const JitComplex& c) : m_Text(text), m_Emitter(emitter), m_Z(z), m_C(c) {}
+
+	/** Parses the whole text.
+	* @param[out] result			Value of the formula.
+	* @returns						False if the text is not a valid formula, the error is printed.
+	*/
+	bool Parse(JitComplex& result) {
+		m_Current = m_Text;
+		result = ParseExpression();
+		SkipSpaces();
+		if (m_Error.empty() && *m_Current) m_Error = "unexpected character";
+		if (m_Error.empty() && m_Emitter.HasInvalidConstant()) m_Error = "constant is not finite";
+		if (!m_Error.empty()) {
+			std::cerr << "Could not parse formula " << m_Text << ": " << m_Error << " at position " << (m_Current - m_Text) << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+private:
+	const char* m_Text;
+	const char* m_Current = nullptr;
+	JitEmitter& m_Emitter;
+	JitComplex m_Z, m_C;
+	std::string m_Error;
+
+	void SkipSpaces() {
+		while (*m_Current == ' ' || *m_Current == '\t') m_Current++;
+	}
+
+	/** Consumes a character if it is next. */
+	bool Accept(char c) {
+		SkipSpaces();
+		if (*m_Current != c) return false;
+		m_Current++;
+		return true;
+	}
+
+	JitComplex Fail(const char* error) {
+		if (m_Error.empty()) m_Error = error;
+		return { JitConstant(0.0), JitConstant(0.0) };
+	}
+
+	JitComplex ParseExpression() {
+		JitComplex value = ParseTerm();
+		while (m_Error.empty()) {
+			if (Accept('+')) value = m_Emitter.Add(value, ParseTerm());
+			else if (Accept('-')) value = m_Emitter.Sub(value, ParseTerm());
+			else break;
+		}
+		return value;
+	}
+
+	JitComplex ParseTerm() {
+		JitComplex value = ParseUnary();
+		while (m_Error.empty()) {
+			if (Accept('*')) value = m_Emitter.Mul(value, ParseUnary());
+			else if (Accept('/')) value = m_Emitter.Div(value, ParseUnary());
+			// Implicit multiplication, as in "2z" or "0.5i".
+			else if (isalpha((unsigned char)*m_Current) || *m_Current == '(') value = m_Emitter.Mul(value, ParseUnary());
+			else break;
+		}
+		return value;
+	}
+
+	JitComplex ParseUnary() {
+		if (Accept('-')) {
+			JitComplex value = ParseUnary();
+			return { m_Emitter.Neg(value.re), m_Emitter.Neg(value.im) };
+		}
+		if (Accept('+')) return ParseUnary();
+		return ParsePower();
+	}
+
+	JitComplex ParsePower() {
+		JitComplex value = ParsePrimary();
+		if (!m_Error.empty() || !Accept('^')) return value;
+
+		SkipSpaces();
+		if (!isdigit((unsigned char)*m_Current)) return Fail("power is not a non-negative integer");
+		char* end;
+		long power = strtol(m_Current, &end, 10);
+		m_Current = end;
+		if (power > JIT_MAX_POWER) return Fail("power is too large");
+		return m_Emitter.Pow(value, (int)power);
+	}
+
+	JitComplex ParsePrimary() {
+		SkipSpaces();
+		if (isdigit((unsigned char)*m_Current) || *m_Current == '.') {
+			char* end;
+			double number = strtod(m_Current, &end);
+			if (end == m_Current) return Fail("invalid number");
+			if (!std::isfinite(number)) return Fail("number is too large");
+			m_Current = end;
+			return { JitConstant(number), JitConstant(0.0) };
+		}
+		if (Accept('(')) {
+			JitComplex value = ParseExpression();
+			if (!Accept(')')) return Fail("missing )");
+			return value;
+		}
+
+		std::string name;
+		while (isalpha((unsigned char)*m_Current)) name += *m_Current++;
+		if (name == "z") return m_Z;
+		if (name == "c") return m_C;
+		if (name == "i") return { JitConstant(0.0), JitConstant(1.0) };
+		if (name != "conj" && name != "abs" && name != "re" && name != "im") return Fail(name.empty() ? "missing operand" : "unknown name");
+
+		if (!Accept('(')) return Fail("missing ( after function");
+		JitComplex argument = ParseExpression();
+		if (!Accept(')')) return Fail("missing )");
+		if (name == "conj") return { argument.re, m_Emitter.Neg(argument.im) };
+		if (name == "abs") return { m_Emitter.Abs(argument.re), m_Emitter.Abs(argument.im) };
+		if (name == "re") return { argument.re, JitConstant(0.0) };
+		return { argument.im, JitConstant(0.0) };
+	}
+};
+
+/* Operations of the generated code on four pixels in an AVX2 register and on a single pixel. */
+static const char* vectorOperations =
+	"#define T __m256d\n"
+	"#define SET(a) _mm256_set1_pd(a)\n"
+	"#define ADD(a, b) _mm256_add_pd(a, b)\n"
+	"#define SUB(a, b) _mm256_sub_pd(a, b)\n"
+	"#define MUL(a, b) _mm256_mul_pd(a, b)\n"
+	"#define DIV(a, b) _mm256_div_pd(a, b)\n"
+	"#define NEG(a) _mm256_xor_pd(a, _mm256_set1_pd(-0.0))\n"
+	"#define ABS(a) _mm256_andnot_pd(_mm256_set1_pd(-0.0), a)\n";
+
+static const char* scalarOperations =
+	"#define T double\n"
+	"#define SET(a) (a)\n"
+	"#define ADD(a, b) ((a) + (b))\n"
+	"#define SUB(a, b) ((a) - (b))\n"
+	"#define MUL(a, b) ((a) * (b))\n"
+	"#define DIV(a, b) ((a) / (b))\n"
+	"#define NEG(a) (-(a))\n"
+	"#define ABS(a) fabs(a)\n";
+
+static const char* undefineOperations = "#undef T\n#undef SET\n#undef ADD\n#undef SUB\n#undef MUL\n#undef DIV\n#undef NEG\n#undef ABS\n";
+
+/** Appends lines of generated code with a fixed indentation. */
+static void AppendLines(std::string& source, const std::vector<std::string>& lines, size_t first, size_t last, const char* indent) {
+	for (size_t line = first; line < last; line++) source += indent + lines[line] + "\n";
+}
+
+bool FormulaJit::Translate(const char* text, std::string& source) {
+	// The bailout radius comes first so the formula can reuse its squares.
+	JitEmitter emitter;
+	JitComplex z = { JitVariable("x"), JitVariable("y") }, c = { JitVariable("cx"), JitVariable("cy") };
+	JitOperand radius = emitter.Add(emitter.Mul(z.re, z.re), emitter.Mul(z.im, z.im));
+	size_t radiusLines = emitter.GetLines().size();
+
+	JitComplex next;
+	if (!JitParser(text, emitter, z, c).Parse(next)) return false;
+	const std::vector<std::string>& lines = emitter.GetLines();
+	std::string step = "\t\tT nx = " + next.re.GetCode() + ", ny = " + next.im.GetCode() + ";\n\t\tx = nx;\n\t\ty = ny;\n";
+
+	// A valid formula can not contain the end of a comment.
+	source = "/* Generated from z = " + std::string(text) + " */\n"
+		"#include <math.h>\n"
+		"#ifdef __AVX2__\n"
+		"#include <immintrin.h>\n"
+		"#endif\n"
+		"#ifdef _WIN32\n"
+		"#define FORMULA_EXPORT __declspec(dllexport)\n"
+		"#else\n"
+		"#define FORMULA_EXPORT\n"
+		"#endif\n\n";
+
+	source += "#ifdef __AVX2__\n";
+	source += vectorOperations;
+	source += "\nstatic void IterateLanes(const double* zx, const double* zy, const double* cxs, const double* cys, int maxIterations, double bailout, int* counts) {\n"
+		"\tT x = _mm256_loadu_pd(zx), y = _mm256_loadu_pd(zy), cx = _mm256_loadu_pd(cxs), cy = _mm256_loadu_pd(cys);\n"
+		"\tconst T limit = SET(bailout), one = SET(1.0);\n"
+		"\tT active = _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), count = _mm256_setzero_pd();\n"
+		"\tfor (int iteration = 0; iteration < maxIterations; iteration++) {\n";
+	AppendLines(source, lines, 0, radiusLines, "\t\t");
+	source += "\t\tactive = _mm256_and_pd(active, _mm256_cmp_pd(" + radius.GetCode() + ", limit, _CMP_LE_OQ));\n"
+		"\t\tif (_mm256_movemask_pd(active) == 0) break;\n";
+	AppendLines(source, lines, radiusLines, lines.size(), "\t\t");
+	source += step;
+	source += "\t\tcount = _mm256_add_pd(count, _mm256_and_pd(active, one));\n"
+		"\t}\n"
+		"\t_mm_storeu_si128((__m128i*)counts, _mm256_cvtpd_epi32(count));\n"
+		"\tfor (int lane = 0; lane < 4; lane++)\n"
+		"\t\tif (counts[lane] >= maxIterations) counts[lane] = -1;\n"
+		"}\n";
+	source += undefineOperations;
+	source += "#endif\n\n";
+
+	source += scalarOperations;
+	source += "\nstatic int IterateSingle(T x, T y, T cx, T cy, int maxIterations, double bailout) {\n"
+		"\tint iteration = 0;\n"
+		"\tfor (; iteration < maxIterations; iteration++) {\n";
+	AppendLines(source, lines, 0, radiusLines, "\t\t");
+	source += "\t\tif (!(" + radius.GetCode() + " <= bailout)) break;\n";
+	AppendLines(source, lines, radiusLines, lines.size(), "\t\t");
+	source += step;
+	source += "\t}\n"
+		"\treturn iteration >= maxIterations ? -1 : iteration;\n"
+		"}\n";
+	source += undefineOperations;
+
+	source += "\nFORMULA_EXPORT void IterateFormulaRow(const double* zx, const double* zy, const double* cx, const double* cy, int count, int maxIterations,\n"
+		"\tdouble bailout, int* iterations) {\n"
+		"\tint i = 0;\n"
+		"#ifdef __AVX2__\n"
+		"\tfor (; i + 4 <= count; i += 4) IterateLanes(zx + i, zy + i, cx + i, cy + i, maxIterations, bailout, iterations + i);\n"
+		"#endif\n"
+		"\tfor (; i < count; i++) iterations[i] = IterateSingle(zx[i], zy[i], cx[i], cy[i], maxIterations, bailout);\n"
+		"}\n";
+	return true;
+}
+
+/** 64-bit FNV-1a hash. */
+static unsigned long long HashString(const std::string& text, unsigned long long hash = 14695981039346656037ull) {
+	for (unsigned char c : text) hash = (hash ^ c) * 1099511628211ull;
+	return hash;
+}
+
+static void ReplaceAll(std::string& text, const std::string& from, const std::string& to) {
+	for (size_t position = text.find(from); position != std::string::npos; position = text.find(from, position + to.size()))
+		text.replace(position, from.size(), to);
+}
+
+static void* LoadLibraryFile(const std::string& path) {
+#ifdef _WIN32
+	return (void*)LoadLibraryA(path.c_str());
+#else
+	return dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+static void* FindSymbol(void* library, const char* name) {
+#ifdef _WIN32
+	return (void*)GetProcAddress((HMODULE)library, name);
+#else
+	return dlsym(library, name);
+#endif
+}
+
+static void FreeLibraryFile(void* library) {
+#ifdef _WIN32
+	FreeLibrary((HMODULE)library);
+#else
+	dlclose(library);
+#endif
+}
+
+FormulaJit::FormulaJit(const FormulaJitSettings& settings) : m_Settings(settings) {}
+
+FormulaJit::~FormulaJit() {
+	for (auto& build : m_Builds) {
+		void* handle = build.second.get().handle;
+		if (handle) FreeLibraryFile(handle);
+	}
+	for (auto& library : m_Libraries)
+		FreeLibraryFile(library.second);
+}
+
+bool FormulaJit::Compile(const char* text) {
+	auto sTime = std::chrono::steady_clock::now();
+	std::string source;
+	if (!Translate(text, source)) return false;
+
+	// Formulas that differ only in spacing translate to the same source and share their library.
+	unsigned long long hash = HashString(m_Settings.command, HashString(source));
+	auto library = m_Libraries.find(hash);
+	if (library != m_Libraries.end()) {
+		m_RequestedText.clear();
+		m_FailedText.clear();
+		Use(library->second, text, true, std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - sTime).count());
+		return true;
+	}
+
+	// A formula requested again while it is built waits for the same build.
+	if (m_Builds.find(hash) == m_Builds.end())
+		m_Builds[hash] = std::async(std::launch::async, [this, source, hash]() { return Build(source, hash); }).share();
+	m_RequestedText = text;
+	m_RequestedHash = hash;
+	return true;
+}
+
+void FormulaJit::Update() {
+	for (auto build = m_Builds.begin(); build != m_Builds.end();) {
+		if (build->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			build++;
+			continue;
+		}
+
+		// Builds of formulas that are no longer requested are kept for later requests.
+		Library library = build->second.get();
+		if (library.handle) m_Libraries[build->first] = library.handle;
+		if (!m_RequestedText.empty() && build->first == m_RequestedHash) {
+			// Build reported why it failed.
+			if (library.handle) Use(library.handle, m_RequestedText, library.cached, library.time);
+			m_FailedText = library.handle ? "" : m_RequestedText;
+			m_RequestedText.clear();
+		}
+		build = m_Builds.erase(build);
+	}
+}
+
+bool FormulaJit::Wait() {
+	auto build = m_Builds.find(m_RequestedHash);
+	if (!m_RequestedText.empty() && build != m_Builds.end()) build->second.wait();
+	Update();
+	return IsReady() && m_FailedText.empty();
+}
+
+void FormulaJit::Use(void* handle, const std::string& text, bool cached, float time) {
+	m_Function = (FormulaRowFunction)FindSymbol(handle, "IterateFormulaRow");
+	m_Text = text;
+	m_Cached = cached;
+	m_CompileTime = time;
+}
+
+FormulaJit::Library FormulaJit::Build(const std::string& source, unsigned long long hash) const {
+	auto sTime = std::chrono::steady_clock::now();
+	Library library = { nullptr, false, 0.0f };
+	char name[32];
+	snprintf(name, sizeof(name), "formula_%016llx", hash);
+	std::string base = m_Settings.cacheDirectory + "/" + name;
+#ifdef _WIN32
+	std::string libraryPath = base + ".dll";
+#else
+	std::string libraryPath = base + ".so";
+#endif
+
+	// Compiled in an earlier run. A library that does not load, e.g. truncated or built for another architecture, is
+	// compiled again.
+	if (std::ifstream(libraryPath).good()) {
+		library.handle = LoadLibraryFile(libraryPath);
+		library.cached = library.handle != nullptr;
+		if (!library.handle) std::cerr << "Could not load cached " << libraryPath << ", compiling it again" << std::endl;
+	}
+
+	if (!library.handle) {
+#ifdef _WIN32
+		_mkdir(m_Settings.cacheDirectory.c_str());
+#else
+		mkdir(m_Settings.cacheDirectory.c_str(), 0755);
+#endif
+		std::string sourcePath = base + ".c";
+		std::ofstream file(sourcePath, std::ios::out | std::ios::trunc);
+		if (!file.is_open()) {
+			std::cerr << "Could not write " << sourcePath << std::endl;
+			return library;
+		}
+		file << source;
+		file.close();
+
+		std::string command = m_Settings.command;
+		ReplaceAll(command, "$SRC", sourcePath);
+		ReplaceAll(command, "$OUT", libraryPath);
+		if (std::system(command.c_str()) != 0) {
+			std::cerr << "Could not compile formula: " << command << std::endl;
+			return library;
+		}
+
+		library.handle = LoadLibraryFile(libraryPath);
+		if (!library.handle) {
+			std::cerr << "Could not load " << libraryPath << std::endl;
+			return library;
+		}
+	}
+
+	if (!FindSymbol(library.handle, "IterateFormulaRow")) {
+		std::cerr << "Could not find IterateFormulaRow in " << libraryPath << std::endl;
+		FreeLibraryFile(library.handle);
+		library.handle = nullptr;
+	}
+	library.time = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - sTime).count();
+	return library;
+}
+
+void FormulaJit::Compute(const View& view, uint width, uint height, int maxIterations, const FormulaParams& params, int* iterations) const {
+	FormulaRowFunction function = m_Function;
+	ForEachTile(width, height, [&](int, uint x0, uint y0, uint x1, uint y1) {
+		// Starting values and constants of a row of the tile.
+		double zx[TILE_SIZE], zy[TILE_SIZE], cx[TILE_SIZE], cy[TILE_SIZE];
+		for (uint y = y0; y < y1; y++) {
+			double py = view.centerY + ((double)y / (double)height - 0.5) * 2.0 * view.zoom;
+			for (uint x = x0; x < x1; x++) {
+				double px = view.centerX + ((double)x / (double)width - 0.5) * 2.0 * view.zoom;
+				zx[x - x0] = params.julia ? px : 0.0, zy[x - x0] = params.julia ? py : 0.0;
+				cx[x - x0] = params.julia ? params.juliaC[0] : px, cy[x - x0] = params.julia ? params.juliaC[1] : py;
+			}
+			function(zx, zy, cx, cy, (int)(x1 - x0), maxIterations, 4.0, iterations + x0 + y * width);
+		}
+	});
+}
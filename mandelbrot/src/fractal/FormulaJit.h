@@ -0,0 +1,115 @@
+#pragma once
+#include "Mandelbrot.h"
+#include "Formula.h"
+#include <future>
+#include <map>
+#include <string>
+
+/* Settings of the formula compiler. */
+struct FormulaJitSettings {
+	/* Command compiling a C file into a shared library, $SRC and $OUT are replaced by the paths. */
+#ifdef _WIN32
+	std::string command = "cl /nologo /O2 /arch:AVX2 /fp:precise /LD \"$SRC\" /Fe\"$OUT\" /Fo\"$OUT.obj\"";
+#else
+	std::string command = "cc -O2 -mavx2 -ffp-contract=off -shared -fPIC \"$SRC\" -o \"$OUT\"";
+#endif
+	/* Directory of the generated sources and the compiled libraries. */
+	std::string cacheDirectory = "formula_cache";
+};
+
+/* Entry point of a compiled formula, iterates a row of pixels with z starting at (zx, zy) and the constants (cx, cy). */
+typedef void (*FormulaRowFunction)(const double* zx, const double* zy, const double* cx, const double* cy, int count, int maxIterations,
+	double bailout, int* iterations);
+
+/** Compiles escape-time formulas typed by the user into native code. The formula is translated to C with the complex
+* arithmetic expanded into real operations, constants folded and common subexpressions shared, once for four pixels in
+* AVX2 registers and once for single pixels. The system compiler builds it into a shared library that is loaded at
+* runtime, so the inner loop is as fast as the hard-coded formulas.
+*
+* Libraries are cached by a hash of their source and the compiler command: in memory for formulas used before in the
+* same run, on disk for formulas used in earlier runs. The system compiler takes a few hundred ms, so libraries are built
+* on background threads and the current formula is kept until the new one is ready.
+*/
+class FormulaJit {
+
+public:
+	FormulaJit(const FormulaJitSettings& settings = FormulaJitSettings());
+	/** Waits for background builds and unloads all libraries. */
+	~FormulaJit();
+
+	/** Requests a formula. It is switched to at once if its library is loaded, otherwise the library is built or loaded from
+	* the disk cache in the background and Update switches to it. The current formula is kept until then, and if it fails.
+	* @param[in] text				Next value of z in terms of z and c, e.g. "z^2 + c" or "abs(z)^2 + c". Numbers, i, + - * /,
+	*								integer powers and the functions conj, abs (|Re x| + |Im x| i), re and im are supported.
+	* @returns						False if the formula could not be parsed.
+	*/
+	bool Compile(const char* text);
+	/** Collects finished builds and switches to the requested formula once it is built, call once per frame. */
+	void Update();
+	/** Blocks until the requested formula is built and switches to it.
+	* @returns						False if its build failed or no formula was requested.
+	*/
+	bool Wait();
+
+	/** Whether a formula has been compiled. */
+	bool IsReady() const { return m_Function != nullptr; }
+	/** Whether the requested formula is still being built. */
+	bool IsPending() const { return !m_RequestedText.empty(); }
+	const std::string& GetText() const { return m_Text; }
+	/** Formula whose last build failed, empty if it succeeded. */
+	const std::string& GetFailedText() const { return m_FailedText; }
+	/** Duration of the last successful Compile in ms and whether it was found in the cache. */
+	float GetCompileTime() const { return m_CompileTime; }
+	bool WasCached() const { return m_Cached; }
+
+	/** Computes the iterations of the whole image with the compiled formula, tiles are distributed over all threads.
+	* "z^2 + c" gives the same results as ComputeFormula. There is no continuous iteration count.
+	* @param[in] view				Region of the complex plane.
+	* @param[in] width				Image width.
+	* @param[in] height				Image height.
+	* @param[in] maxIterations		Maximum number of iterations.
+	* @param[in] params				Julia constant, the formula type is ignored.
+	* @param[out] iterations		Iteration count per pixel, -1 inside the set. Of size width * height.
+	*/
+	void Compute(const View& view, uint width, uint height, int maxIterations, const FormulaParams& params, int* iterations) const;
+
+	/** Translates a formula to C without compiling it.
+	* @param[in] text				Formula, as for Compile.
+	* @param[out] source			C source exporting IterateFormulaRow as a FormulaRowFunction.
+	* @returns						False if the formula could not be parsed.
+	*/
+	static bool Translate(const char* text, std::string& source);
+
+private:
+	/** Result of a background build. */
+	struct Library {
+		/** Library handle, nullptr if the build failed. */
+		void* handle;
+		/** Whether the library was on disk already. */
+		bool cached;
+		/** Duration of the build in ms. */
+		float time;
+	};
+
+	FormulaJitSettings m_Settings;
+	/** Loaded libraries by the hash of their source and command. */
+	std::map<unsigned long long, void*> m_Libraries;
+	/** Running builds by the hash of their source and command. */
+	std::map<unsigned long long, std::shared_future<Library>> m_Builds;
+
+	FormulaRowFunction m_Function = nullptr;
+	std::string m_Text, m_FailedText;
+	float m_CompileTime = 0.0f;
+	bool m_Cached = false;
+
+	/** Formula waiting for its build, empty if none. */
+	std::string m_RequestedText;
+	unsigned long long m_RequestedHash = 0;
+
+	/** Compiles a source into a library unless it loads from disk already, runs on a background thread.
+	* @returns						The library, with a nullptr handle if it failed.
+	*/
+	Library Build(const std::string& source, unsigned long long hash) const;
+	/** Switches to a loaded library that exports the entry point. */
+	void Use(void* handle, const std::string& text, bool cached, float time);
+};
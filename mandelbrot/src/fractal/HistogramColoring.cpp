@@ -0,0 +1,80 @@
+#include "HistogramColoring.h"
+#include <algorithm>
+#include <omp.h>
+
+void HistogramColoring::Update(const int* iterations, size_t pixels, int maxIterations) {
+	const int threads = omp_get_max_threads();
+	m_Bins = maxIterations + 1;
+	m_Histograms.resize((size_t)threads * m_Bins);
+	m_Distribution.resize(m_Bins + 1);
+	std::vector<unsigned long long> blockSums(threads + 1, 0);
+
+#pragma omp parallel num_threads(threads)
+	{
+		const int thread = omp_get_thread_num(), team = omp_get_num_threads();
+		unsigned int* histogram = &m_Histograms[(size_t)thread * m_Bins];
+		std::fill(histogram, histogram + m_Bins, 0);
+
+		// Private histograms, no atomics on the hot path. Inside pixels are not counted.
+#pragma omp for schedule(static)
+		for (long long p = 0; p < (long long)pixels; p++) {
+			int i = iterations[p];
+			if (i >= 0) histogram[std::min(i, m_Bins - 1)]++;
+		}
+
+		// Every thread merges and scans its own range of bins.
+		const int begin = (int)((long long)m_Bins * thread / team), end = (int)((long long)m_Bins * (thread + 1) / team);
+		unsigned long long sum = 0;
+		for (int b = begin; b < end; b++) {
+			unsigned int count = 0;
+			for (int t = 0; t < team; t++) count += m_Histograms[(size_t)t * m_Bins + b];
+			m_Histograms[b] = count;
+			sum += count;
+		}
+		blockSums[thread + 1] = sum;
+
+#pragma omp barrier
+#pragma omp single
+		for (int t = 0; t < team; t++) blockSums[t + 1] += blockSums[t];
+
+		const float invTotal = blockSums[team] > 0 ? 1.0f / (float)blockSums[team] : 0.0f;
+		unsigned long long below = blockSums[thread];
+		for (int b = begin; b < end; b++) {
+			m_Distribution[b] = (float)below * invTotal;
+			below += m_Histograms[b];
+		}
+		if (thread == team - 1) m_Distribution[m_Bins] = (float)below * invTotal;
+	}
+}
+
+float HistogramColoring::Map(float value, float scale) const {
+	if (value < 0.0f || m_Bins == 0) return -1.0f;
+	int i = std::min((int)value, m_Bins - 1);
+	float t = std::min(value - (float)i, 1.0f);
+	return (m_Distribution[i] + (m_Distribution[i + 1] - m_Distribution[i]) * t) * scale;
+}
+
+void HistogramColoring::Remap(const int* iterations, const float* smooth, size_t pixels, float scale, float* equalized) const {
+	const float* distribution = m_Distribution.data();
+	const int last = m_Bins - 1;
+	if (smooth) {
+#pragma omp parallel for schedule(static)
+		for (long long p = 0; p < (long long)pixels; p++) {
+			float s = smooth[p];
+			if (s < 0.0f) {
+				equalized[p] = -1.0f;
+				continue;
+			}
+			int i = std::min((int)s, last);
+			float t = std::min(s - (float)i, 1.0f);
+			equalized[p] = (distribution[i] + (distribution[i + 1] - distribution[i]) * t) * scale;
+		}
+	}
+	else {
+#pragma omp parallel for schedule(static)
+		for (long long p = 0; p < (long long)pixels; p++) {
+			int i = iterations[p];
+			equalized[p] = i < 0 ? -1.0f : distribution[std::min(i, last)] * scale;
+		}
+	}
+}
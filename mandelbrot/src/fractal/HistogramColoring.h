@@ -0,0 +1,40 @@
+#pragma once
+#include "tmpl/incl.h"
+
+/** Histogram-equalized coloring: every escaped pixel is mapped to the fraction of escaped pixels that needed fewer
+* iterations, so the colors are spread evenly over the image regardless of the zoom depth. Buffers are kept between frames.
+*/
+class HistogramColoring {
+
+public:
+	/** Builds the cumulative distribution of the escaped iteration counts of a frame. Every thread fills its own histogram,
+	* the histograms are merged per range of bins in parallel and the distribution is a blocked parallel prefix sum.
+	* @param[in] iterations			Iteration count per pixel, -1 inside the set.
+	* @param[in] pixels				Number of pixels.
+	* @param[in] maxIterations		Maximum number of iterations the frame was computed with.
+	*/
+	void Update(const int* iterations, size_t pixels, int maxIterations);
+
+	/** Maps the pixels through the distribution of the last Update.
+	* @param[in] iterations			Iteration count per pixel, -1 inside the set.
+	* @param[in] smooth				Continuous iteration count per pixel, nullptr to map the integer counts.
+	* @param[in] pixels				Number of pixels.
+	* @param[in] scale				Value the distribution is scaled to, e.g. the palette period.
+	* @param[out] equalized			Equalized value per pixel in [0, scale], -1 inside the set.
+	*/
+	void Remap(const int* iterations, const float* smooth, size_t pixels, float scale, float* equalized) const;
+
+	/** Maps a single iteration count through the distribution of the last Update.
+	* @param[in] value				Continuous or integer iteration count, negative inside the set.
+	* @param[in] scale				Value the distribution is scaled to.
+	* @returns						Equalized value in [0, scale], -1 inside the set.
+	*/
+	float Map(float value, float scale) const;
+
+private:
+	/* Histogram per thread, each of m_Bins counts. */
+	std::vector<unsigned int> m_Histograms;
+	/* Fraction of escaped pixels below each iteration count, m_Bins + 1 entries. */
+	std::vector<float> m_Distribution;
+	int m_Bins = 0;
+};
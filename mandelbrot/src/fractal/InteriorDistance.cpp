@@ -0,0 +1,114 @@
+#include "InteriorDistance.h"
+#include "tmpl/Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+typedef std::complex<double> complex;
+
+/* Squared distance at which an orbit counts as having returned to its reference point. */
+#define CYCLE_EPSILON 1e-20
+/* Newton steps refining the periodic point. */
+#define NEWTON_STEPS 8
+
+double InteriorDistance(double cx, double cy, int maxIterations, int* period) {
+	if (period) *period = 0;
+	const complex c(cx, cy);
+
+	// Brent's cycle detection: the reference point moves to the orbit at every power of two.
+	complex z = 0.0, reference = 0.0;
+	int p = 0, next = 1, referenceIteration = 0;
+	for (int i = 1; i <= maxIterations; i++) {
+		z = z * z + c;
+		if (std::norm(z) > 4.0) return -1.0;
+		if (std::norm(z - reference) < CYCLE_EPSILON) {
+			p = i - referenceIteration;
+			break;
+		}
+		if (i == next) {
+			reference = z, referenceIteration = i;
+			next *= 2;
+		}
+	}
+	if (p == 0) return -1.0;
+
+	// Newton's method on f^p(z) - z, the derivative of f^p is the product of 2 z along the cycle.
+	complex z0 = z;
+	for (int n = 0; n < NEWTON_STEPS; n++) {
+		complex w = z0, dz = 1.0;
+		for (int k = 0; k < p; k++) {
+			dz = 2.0 * w * dz;
+			w = w * w + c;
+		}
+		complex step = (w - z0) / (dz - 1.0);
+		z0 -= step;
+		if (std::norm(step) < CYCLE_EPSILON) break;
+	}
+
+	// First and second derivatives of f^p with respect to z and c at the periodic point.
+	complex w = z0, dz = 1.0, dc = 0.0, dzdz = 0.0, dcdz = 0.0;
+	for (int k = 0; k < p; k++) {
+		dcdz = 2.0 * (dz * dc + w * dcdz);
+		dzdz = 2.0 * (dz * dz + w * dzdz);
+		dc = 2.0 * w * dc + 1.0;
+		dz = 2.0 * w * dz;
+		w = w * w + c;
+	}
+	// Only attracting cycles lie in the interior.
+	if (std::norm(dz) >= 1.0) return -1.0;
+
+	if (period) *period = p;
+	return (1.0 - std::norm(dz)) / std::abs(dcdz + dzdz * dc / (1.0 - dz));
+}
+
+/** Marks a block as interior if the interior distance at its center covers it, otherwise subdivides it or iterates its pixels.
+* @returns						Number of pixels marked without iterating them.
+*/
+static size_t ComputeBlock(const View& view, uint width, uint height, int maxIterations, uint x0, uint y0, uint x1, uint y1,
+	int* iterations, float* smooth, unsigned int& tests) {
+	const double pixelX = 2.0 * view.zoom / width, pixelY = 2.0 * view.zoom / height;
+	double cx = view.centerX + (((double)x0 + (double)(x1 - 1)) * 0.5 / (double)width - 0.5) * 2.0 * view.zoom;
+	double cy = view.centerY + (((double)y0 + (double)(y1 - 1)) * 0.5 / (double)height - 0.5) * 2.0 * view.zoom;
+	double radius = std::hypot((x1 - 1 - x0) * 0.5 * pixelX, (y1 - 1 - y0) * 0.5 * pixelY);
+
+	tests++;
+	double distance = InteriorDistance(cx, cy, maxIterations);
+	if (distance > 0.0 && 0.25 * distance > radius) {
+		for (uint y = y0; y < y1; y++) {
+			std::fill(iterations + x0 + y * width, iterations + x1 + y * width, -1);
+			if (smooth) std::fill(smooth + x0 + y * width, smooth + x1 + y * width, -1.0f);
+		}
+		return (size_t)(x1 - x0) * (y1 - y0);
+	}
+
+	// A center that escapes says nothing about the rest of the block, and small blocks do not pay for the test.
+	if (distance < 0.0 || x1 - x0 <= INTERIOR_MIN_BLOCK || y1 - y0 <= INTERIOR_MIN_BLOCK) {
+		ComputeTile(view, width, height, maxIterations, x0, y0, x1, y1, iterations, smooth);
+		return 0;
+	}
+
+	uint xm = (x0 + x1) / 2, ym = (y0 + y1) / 2;
+	return ComputeBlock(view, width, height, maxIterations, x0, y0, xm, ym, iterations, smooth, tests) +
+		ComputeBlock(view, width, height, maxIterations, xm, y0, x1, ym, iterations, smooth, tests) +
+		ComputeBlock(view, width, height, maxIterations, x0, ym, xm, y1, iterations, smooth, tests) +
+		ComputeBlock(view, width, height, maxIterations, xm, ym, x1, y1, iterations, smooth, tests);
+}
+
+void ComputeIterationsSkipInterior(const View& view, uint width, uint height, int maxIterations, int* iterations, float* smooth,
+	InteriorSkipStats* stats) {
+	// Counts per tile, summed after all tiles are done.
+	std::vector<unsigned long long> tileSkipped(GetTileCount(width, height));
+	std::vector<unsigned int> tileTests(GetTileCount(width, height));
+	ForEachTile(width, height, [&](int tile, uint x0, uint y0, uint x1, uint y1) {
+		tileSkipped[tile] = ComputeBlock(view, width, height, maxIterations, x0, y0, x1, y1, iterations, smooth, tileTests[tile]);
+	});
+
+	if (stats) {
+		unsigned long long skipped = 0;
+		unsigned int tests = 0;
+		for (size_t tile = 0; tile < tileSkipped.size(); tile++) skipped += tileSkipped[tile], tests += tileTests[tile];
+		stats->skippedFraction = (float)skipped / (float)(width * height);
+		stats->tests = tests;
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "Mandelbrot.h"
+
+/* Smallest block in pixels the interior test subdivides to before iterating the pixels. */
+#define INTERIOR_MIN_BLOCK 8
+
+/* Statistics of the last frame computed with interior skipping. */
+struct InteriorSkipStats {
+	/* Fraction of pixels marked as interior without iterating them. */
+	float skippedFraction = 0.0f;
+	/* Number of blocks tested. */
+	unsigned int tests = 0;
+};
+
+/** Estimates the distance from an interior point to the boundary of the set. The attracting cycle of the orbit is found
+* with Brent's cycle detection, its periodic point refined with Newton's method, and the distance follows from the
+* derivatives of the cycle. The true distance is between a quarter of the estimate and the estimate.
+* @param[in] cx, cy				Point of the complex plane.
+* @param[in] maxIterations		Maximum number of iterations to find the cycle in.
+* @param[out] period			Optional period of the attracting cycle, 0 if none was found.
+* @returns						Estimated distance, -1 if the point escaped or no attracting cycle was found.
+*/
+double InteriorDistance(double cx, double cy, int maxIterations, int* period = nullptr);
+
+/** Computes the iterations of the whole image like ComputeIterations, but first tests every tile with the interior distance
+* estimate at its center. Tiles that lie completely within a quarter of the estimate are marked as interior without
+* iterating their pixels, other tiles are subdivided down to INTERIOR_MIN_BLOCK pixels.
+* @param[in] view				Region of the complex plane.
+* @param[in] width				Image width.
+* @param[in] height				Image height.
+* @param[in] maxIterations		Maximum number of iterations.
+* @param[out] iterations		Iteration count per pixel, -1 inside the set. Of size width * height.
+* @param[out] smooth			Optional continuous iteration count per pixel, -1 inside the set.
+* @param[out] stats				Optional statistics of the skipped pixels.
+*/
+void ComputeIterationsSkipInterior(const View& view, uint width, uint height, int maxIterations, int* iterations, float* smooth = nullptr,
+	InteriorSkipStats* stats = nullptr);
@@ -0,0 +1,62 @@
+#include "IterationStats.h"
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+void ComputeIterationStats(const int* iterations, uint width, uint height, int maxIterations, IterationStats& stats) {
+	int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	std::vector<unsigned long long> tileCost(tilesX * tilesY, 0);
+
+	stats = IterationStats();
+	stats.maxIterations = maxIterations;
+	unsigned long long total = 0, interior = 0, late = 0;
+	const int lateStart = maxIterations - (int)(maxIterations * LATE_ESCAPE_FRACTION);
+
+	// Every thread fills its own histogram over whole rows, merged afterwards.
+#pragma omp parallel reduction(+ : total, interior, late)
+	{
+		unsigned int histogram[HISTOGRAM_BINS] = {};
+		std::vector<unsigned long long> rowCost(tilesX);
+
+#pragma omp for schedule(static)
+		for (int ty = 0; ty < tilesY; ty++) {
+			std::fill(rowCost.begin(), rowCost.end(), 0);
+			uint y1 = std::min((uint)(ty + 1) * TILE_SIZE, height);
+			for (uint y = ty * TILE_SIZE; y < y1; y++)
+				for (uint x = 0; x < width; x++) {
+					int i = iterations[x + y * width];
+					int cost = i < 0 ? maxIterations : i;
+					interior += i < 0;
+					late += i >= lateStart;
+					total += cost;
+					rowCost[x / TILE_SIZE] += cost;
+					histogram[std::min((int)((long long)cost * HISTOGRAM_BINS / (maxIterations + 1)), HISTOGRAM_BINS - 1)]++;
+				}
+			std::copy(rowCost.begin(), rowCost.end(), tileCost.begin() + ty * tilesX);
+		}
+
+#pragma omp critical
+		for (int b = 0; b < HISTOGRAM_BINS; b++) stats.histogram[b] += histogram[b];
+	}
+
+	stats.totalIterations = total;
+	stats.interiorFraction = (float)interior / (float)(width * height);
+	stats.lateEscapeFraction = (float)late / (float)(width * height);
+
+	unsigned long long maxTile = *std::max_element(tileCost.begin(), tileCost.end());
+	double meanTile = (double)total / tileCost.size();
+	stats.tileImbalance = meanTile > 0.0 ? (float)(maxTile / meanTile) : 1.0f;
+}
+
+void DrawCostHeatmap(const int* iterations, size_t pixels, int maxIterations, float opacity, Color* colors) {
+#pragma omp parallel for
+	for (long long p = 0; p < (long long)pixels; p++) {
+		int i = iterations[p];
+		float t = i < 0 ? 1.0f : (float)i / (float)maxIterations;
+		// Blue through green to red.
+		Color heat(std::min(1.0f, 2.0f * t), 1.0f - std::abs(2.0f * t - 1.0f), std::max(0.0f, 1.0f - 2.0f * t));
+		Color& c = colors[p];
+		c = Color(c.r + (heat.r - c.r) * opacity, c.g + (heat.g - c.g) * opacity, c.b + (heat.b - c.b) * opacity);
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "Mandelbrot.h"
+
+/* Number of histogram bins. */
+#define HISTOGRAM_BINS 64
+/* Part of the iteration range at the end counted as late escapes. */
+#define LATE_ESCAPE_FRACTION 0.125f
+
+/* Per-frame statistics of the iteration counts. The cost of a pixel is its iteration count, maxIterations for pixels inside the set. */
+struct IterationStats {
+	/* Number of pixels per bin, bins evenly divide [0, maxIterations]. */
+	unsigned int histogram[HISTOGRAM_BINS] = {};
+	int maxIterations = 0;
+	/* Summed cost of all pixels. */
+	unsigned long long totalIterations = 0;
+	/* Fraction of pixels inside the set. */
+	float interiorFraction = 0.0f;
+	/* Fraction of pixels that escaped within the last LATE_ESCAPE_FRACTION of maxIterations. */
+	float lateEscapeFraction = 0.0f;
+	/* Highest summed cost of a TILE_SIZE tile divided by the mean tile cost, 1 for a perfectly balanced frame. */
+	float tileImbalance = 0.0f;
+};
+
+/** Computes the histogram and cost statistics of a frame.
+* @param[in] iterations			Iteration count per pixel, -1 inside the set. Of size width * height.
+* @param[in] width				Image width.
+* @param[in] height				Image height.
+* @param[in] maxIterations		Maximum number of iterations the frame was computed with.
+* @param[out] stats				Statistics of the frame.
+*/
+void ComputeIterationStats(const int* iterations, uint width, uint height, int maxIterations, IterationStats& stats);
+
+/** Blends a heatmap of the per-pixel cost over the colors, from blue (cheap) to red (maxIterations).
+* @param[in] iterations			Iteration count per pixel, -1 inside the set. Of size width * height.
+* @param[in] pixels				Number of pixels.
+* @param[in] maxIterations		Maximum number of iterations the frame was computed with.
+* @param[in] opacity			Opacity of the heatmap, 1 replaces the colors.
+* @param[in,out] colors			Colors to draw the heatmap over.
+*/
+void DrawCostHeatmap(const int* iterations, size_t pixels, int maxIterations, float opacity, Color* colors);
@@ -0,0 +1,105 @@
+#include "JuliaGrid.h"
+#include "tmpl/Trace.h"
+#include <algorithm>
+#include <chrono>
+
+/** Computes one row of a group of at most four images, one image per lane. */
+template <typename Formula> static void ComputeJuliaRow(const double* cx, const double* cy, int lanes, uint size, double extent,
+	int maxIterations, uint y, int* iterations) {
+	const size_t imageSize = (size_t)size * size;
+	// Same pixel mapping as ComputeFormula for a view centered on the origin.
+	double py = ((double)y / (double)size - 0.5) * 2.0 * extent;
+
+#ifdef __AVX2__
+	if (lanes == 4) {
+		const double4 vcx = _mm256_loadu_pd(cx), vcy = _mm256_loadu_pd(cy);
+		for (uint x = 0; x < size; x++) {
+			double px = ((double)x / (double)size - 0.5) * 2.0 * extent;
+			int counts[4];
+			float radii[4];
+			IterateLanes<Formula>(double4(px), double4(py), vcx, vcy, maxIterations, 4.0, counts, radii);
+			for (int lane = 0; lane < 4; lane++) iterations[lane * imageSize + x + y * size] = counts[lane];
+		}
+		return;
+	}
+#endif
+	for (int lane = 0; lane < lanes; lane++)
+		for (uint x = 0; x < size; x++) {
+			double px = ((double)x / (double)size - 0.5) * 2.0 * extent;
+			float r2;
+			iterations[lane * imageSize + x + y * size] = IterateFormula<Formula>(px, py, cx[lane], cy[lane], maxIterations, 4.0, r2);
+		}
+}
+
+template <typename Formula> static void ComputeJuliaBatch(const double* cx, const double* cy, int count, uint size, double extent,
+	int maxIterations, int* iterations) {
+	const int groups = (count + 3) / 4;
+	const size_t imageSize = (size_t)size * size;
+
+	// A single dispatch over all rows of all groups, the images are too small to parallelize one by one.
+#pragma omp parallel
+	{
+#pragma omp for schedule(dynamic, 1) nowait
+		for (int item = 0; item < groups * (int)size; item++) {
+			int group = item / (int)size, first = group * 4;
+			ComputeJuliaRow<Formula>(cx + first, cy + first, std::min(4, count - first), size, extent, maxIterations,
+				(uint)(item % (int)size), iterations + first * imageSize);
+		}
+
+		TRACE_SCOPE("cpu", "wait");
+#pragma omp barrier
+	}
+}
+
+void ComputeJuliaBatch(FormulaType type, const double* cx, const double* cy, int count, uint size, double extent, int maxIterations, int* iterations) {
+	TRACE_SCOPE("cpu", "julia batch");
+	switch (type) {
+	case FormulaType::BurningShip: ComputeJuliaBatch<BurningShipFormula>(cx, cy, count, size, extent, maxIterations, iterations); break;
+	case FormulaType::Tricorn: ComputeJuliaBatch<TricornFormula>(cx, cy, count, size, extent, maxIterations, iterations); break;
+	case FormulaType::Multibrot3: ComputeJuliaBatch<MultibrotFormula<3>>(cx, cy, count, size, extent, maxIterations, iterations); break;
+	case FormulaType::Multibrot4: ComputeJuliaBatch<MultibrotFormula<4>>(cx, cy, count, size, extent, maxIterations, iterations); break;
+	case FormulaType::Multibrot5: ComputeJuliaBatch<MultibrotFormula<5>>(cx, cy, count, size, extent, maxIterations, iterations); break;
+	default: ComputeJuliaBatch<MandelbrotFormula>(cx, cy, count, size, extent, maxIterations, iterations); break;
+	}
+}
+
+void JuliaGrid::Render(FormulaType type, double cx, double cy, double pixelSize) {
+	auto sTime = std::chrono::steady_clock::now();
+	m_Columns = std::max(m_Settings.columns, 1), m_Rows = std::max(m_Settings.rows, 1), m_Size = std::max(m_Settings.size, 1);
+	const int count = m_Columns * m_Rows;
+	m_Cx.resize(count);
+	m_Cy.resize(count);
+	m_Iterations.resize((size_t)count * m_Size * m_Size);
+
+	// Row 0 is the bottom row of the grid, like the rows of the frame.
+	const double spacing = m_Settings.spacing * pixelSize;
+	for (int j = 0; j < m_Rows; j++)
+		for (int i = 0; i < m_Columns; i++) {
+			m_Cx[i + j * m_Columns] = cx + (i - m_Columns / 2) * spacing;
+			m_Cy[i + j * m_Columns] = cy + (j - m_Rows / 2) * spacing;
+		}
+
+	ComputeJuliaBatch(type, m_Cx.data(), m_Cy.data(), count, m_Size, m_Settings.extent, m_Settings.maxIterations, m_Iterations.data());
+	m_RenderTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sTime).count();
+}
+
+void JuliaGrid::Draw(const Palette& palette, Color* colors, uint width, uint height) const {
+	if (m_Iterations.empty()) return;
+	// Thumbnails are separated by a gap that shows the frame below.
+	const int gap = 2, cell = m_Size + gap;
+	const int left = (int)width - m_Columns * cell, bottom = (int)height - m_Rows * cell;
+	const size_t imageSize = (size_t)m_Size * m_Size;
+
+#pragma omp parallel for
+	for (int row = 0; row < m_Rows * m_Size; row++) {
+		int j = row / m_Size, y = row % m_Size, py = bottom + j * cell + y;
+		if (py < 0 || py >= (int)height) continue;
+		for (int i = 0; i < m_Columns; i++) {
+			const int* image = &m_Iterations[(i + j * m_Columns) * imageSize];
+			for (int x = 0; x < m_Size; x++) {
+				int px = left + i * cell + x;
+				if (px >= 0) colors[px + py * width] = palette.GetColor(image[x + y * m_Size]);
+			}
+		}
+	}
+}
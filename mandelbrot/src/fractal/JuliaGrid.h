@@ -0,0 +1,61 @@
+#pragma once
+#include "Formula.h"
+#include "Palette.h"
+#include <vector>
+
+/* Layout of the Julia set preview grid. */
+struct JuliaGridSettings {
+	/* Thumbnails per row and column, the center thumbnail is the Julia set of c itself. */
+	int columns = 7, rows = 7;
+	/* Width and height of a thumbnail in pixels. */
+	int size = 64;
+	/* Distance between the c values of neighbouring thumbnails, in pixels of the view. */
+	float spacing = 12.0f;
+	int maxIterations = 128;
+	/* Half the width of the region of the complex plane every thumbnail shows, centered on the origin. */
+	double extent = 1.6;
+};
+
+/** Computes a batch of small Julia sets in one parallel dispatch. Four images are computed together, the lanes of a
+* vector iterate the same pixel of four different images: neighbouring c values have similar Julia sets, so the lanes
+* of a vector tend to escape together. Every image gives the same iterations as ComputeFormula of its Julia set.
+* @param[in] type				Formula the Julia sets are iterated with.
+* @param[in] cx, cy				Constant c per image.
+* @param[in] count				Number of images.
+* @param[in] size				Width and height of every image.
+* @param[in] extent				Half the width of the region of the complex plane of every image.
+* @param[in] maxIterations		Maximum number of iterations.
+* @param[out] iterations		Iteration count per pixel, -1 inside the set. The images are stored one after another, of size count * size * size.
+*/
+void ComputeJuliaBatch(FormulaType type, const double* cx, const double* cy, int count, uint size, double extent, int maxIterations, int* iterations);
+
+/** Grid of Julia set thumbnails for the c values around a point of the view, drawn over the frame. */
+class JuliaGrid {
+
+public:
+	/** Computes the thumbnails around a point.
+	* @param[in] type				Formula the Julia sets are iterated with.
+	* @param[in] cx, cy				Constant c of the center thumbnail.
+	* @param[in] pixelSize			Width of a pixel of the view in the complex plane, scales the spacing of the c values.
+	*/
+	void Render(FormulaType type, double cx, double cy, double pixelSize);
+	/** Draws the last computed thumbnails in the top-right corner of a color-buffer.
+	* @param[in] palette			Palette the iteration counts are colored with.
+	* @param[in,out] colors		Color-buffer of the frame.
+	* @param[in] width				Width of the color-buffer.
+	* @param[in] height			Height of the color-buffer.
+	*/
+	void Draw(const Palette& palette, Color* colors, uint width, uint height) const;
+
+	JuliaGridSettings& GetSettings() { return m_Settings; }
+	/** Time the last Render took (in ms). */
+	double GetRenderTime() const { return m_RenderTime; }
+
+private:
+	JuliaGridSettings m_Settings;
+	/* Layout and c values of the last Render, the settings may change in between. */
+	int m_Columns = 0, m_Rows = 0, m_Size = 0;
+	std::vector<double> m_Cx, m_Cy;
+	std::vector<int> m_Iterations;
+	double m_RenderTime = 0.0;
+};
@@ -0,0 +1,201 @@
+#include "Lyapunov.h"
+#include "Formula.h"
+#include "tmpl/Trace.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/* A sequence as a table of steps, step k uses b if isB[k]. */
+struct LyapunovSequence {
+	int length = 0;
+	bool isB[LYAPUNOV_MAX_SEQUENCE];
+};
+
+/** Bit k is set if step k of a sequence uses b. */
+constexpr uint32_t SequenceBits(const char* sequence, int k = 0) {
+	return sequence[k] ? ((sequence[k] == 'B' ? 1u : 0u) << k) | SequenceBits(sequence, k + 1) : 0u;
+}
+
+constexpr int SequenceLength(const char* sequence) {
+	return sequence[0] ? 1 + SequenceLength(sequence + 1) : 0;
+}
+
+/** One step of the logistic map x = r * x * (1 - x), the derivative r * (1 - 2x) is multiplied into the product when
+* accumulating. T is double or double4.
+*/
+template <bool Accumulate, typename T> static inline void LyapunovStep(T& x, T& product, const T& r) {
+	if (Accumulate) product = product * Abs(r * (T(1.0) - T(2.0) * x));
+	x = r * x * (T(1.0) - x);
+}
+
+/** Runs one whole sequence. A compiled sequence (Length > 0) selects a or b at compile time and is unrolled, Length 0
+* looks the steps up in the table.
+*/
+template <uint32_t Bits, int Length, bool Accumulate, typename T> static inline void LyapunovPeriod(T& x, T& product, const T& a, const T& b,
+	const LyapunovSequence& sequence) {
+	if (Length > 0)
+		for (int k = 0; k < Length; k++) LyapunovStep<Accumulate>(x, product, (Bits >> k) & 1 ? b : a);
+	else
+		for (int k = 0; k < sequence.length; k++) LyapunovStep<Accumulate>(x, product, sequence.isB[k] ? b : a);
+}
+
+/** Moves the binary exponent of the product into the exponent sum, leaving the mantissa in [1, 2). Exact, as it only
+* moves bits. The product of a sequence of at most LYAPUNOV_MAX_SEQUENCE derivatives, each at most 4, can not overflow.
+*/
+static inline void Renormalize(double& product, double& exponent) {
+	uint64_t bits;
+	memcpy(&bits, &product, sizeof(bits));
+	exponent += (double)((int)(bits >> 52) - 1023);
+	bits = (bits & 0x000fffffffffffffull) | 0x3ff0000000000000ull;
+	memcpy(&product, &bits, sizeof(bits));
+}
+
+#ifdef __AVX2__
+static inline void Renormalize(double4& product, double4& exponent) {
+	__m256i bits = _mm256_castpd_si256(product.v);
+	// The exponents are in the low halves of the 64-bit lanes, gather them for the conversion.
+	__m256i biased = _mm256_permutevar8x32_epi32(_mm256_srli_epi64(bits, 52), _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0));
+	exponent = exponent + double4(_mm256_cvtepi32_pd(_mm_sub_epi32(_mm256_castsi256_si128(biased), _mm_set1_epi32(1023))));
+	bits = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000fffffffffffffll)), _mm256_set1_epi64x(0x3ff0000000000000ll));
+	product = _mm256_castsi256_pd(bits);
+}
+
+/* Two vectors of four doubles. The logistic map is a single chain of dependent multiplications, iterating two
+* independent vectors interleaves two chains to hide their latency.
+*/
+struct double4x2 {
+	double4 lo, hi;
+	double4x2(double s) : lo(s), hi(s) {}
+	double4x2(double4 lo, double4 hi) : lo(lo), hi(hi) {}
+};
+static inline double4x2 operator-(const double4x2& a, const double4x2& b) { return double4x2(a.lo - b.lo, a.hi - b.hi); }
+static inline double4x2 operator*(const double4x2& a, const double4x2& b) { return double4x2(a.lo * b.lo, a.hi * b.hi); }
+static inline double4x2 Abs(const double4x2& a) { return double4x2(Abs(a.lo), Abs(a.hi)); }
+static inline void Renormalize(double4x2& product, double4x2& exponent) {
+	Renormalize(product.lo, exponent.lo);
+	Renormalize(product.hi, exponent.hi);
+}
+#endif
+
+/** Iterates the logistic map from x = 0.5 and accumulates the derivatives.
+* @param[out] product, exponent	The product of the derivatives is product * 2^exponent.
+*/
+template <uint32_t Bits, int Length, typename T> static inline void LyapunovProduct(const T& a, const T& b, const LyapunovSequence& sequence,
+	int warmupPeriods, int periods, T& product, T& exponent) {
+	T x = 0.5, unused = 1.0;
+	product = 1.0, exponent = 0.0;
+	for (int p = 0; p < warmupPeriods; p++) LyapunovPeriod<Bits, Length, false>(x, unused, a, b, sequence);
+	for (int p = 0; p < periods; p++) {
+		LyapunovPeriod<Bits, Length, true>(x, product, a, b, sequence);
+		Renormalize(product, exponent);
+	}
+}
+
+/** Computes the exponents of a rectangular part of the image for one sequence, eight pixels at a time with AVX2. */
+template <uint32_t Bits, int Length> static void ComputeLyapunovTile(const View& view, uint width, uint height, const LyapunovSequence& sequence,
+	int warmupPeriods, int periods, uint x0, uint y0, uint x1, uint y1, float* exponents) {
+	// ln 2 over the number of accumulated steps turns the base 2 sum into the average natural logarithm.
+	const double scale = 0.6931471805599453 / ((double)periods * sequence.length);
+
+	for (uint y = y0; y < y1; y++) {
+		double b = view.centerY + ((double)y / (double)height - 0.5) * 2.0 * view.zoom;
+		uint x = x0;
+
+#ifdef __AVX2__
+		for (; x + 8 <= x1; x += 8) {
+			double as[8], products[8], sums[8];
+			for (int lane = 0; lane < 8; lane++) as[lane] = view.centerX + ((double)(x + lane) / (double)width - 0.5) * 2.0 * view.zoom;
+			double4x2 a(_mm256_loadu_pd(as), _mm256_loadu_pd(as + 4)), product(1.0), exponent(0.0);
+			LyapunovProduct<Bits, Length>(a, double4x2(b), sequence, warmupPeriods, periods, product, exponent);
+
+			_mm256_storeu_pd(products, product.lo.v);
+			_mm256_storeu_pd(products + 4, product.hi.v);
+			_mm256_storeu_pd(sums, exponent.lo.v);
+			_mm256_storeu_pd(sums + 4, exponent.hi.v);
+			for (int lane = 0; lane < 8; lane++) exponents[x + lane + y * width] = (float)((sums[lane] + std::log2(products[lane])) * scale);
+		}
+#endif
+		for (; x < x1; x++) {
+			double a = view.centerX + ((double)x / (double)width - 0.5) * 2.0 * view.zoom;
+			double product, exponent;
+			LyapunovProduct<Bits, Length>(a, b, sequence, warmupPeriods, periods, product, exponent);
+			exponents[x + y * width] = (float)((exponent + std::log2(product)) * scale);
+		}
+	}
+}
+
+typedef void (*LyapunovTileFunction)(const View&, uint, uint, const LyapunovSequence&, int, int, uint, uint, uint, uint, float*);
+
+/* Sequences with a compiled kernel. */
+struct CompiledSequence {
+	const char* sequence;
+	LyapunovTileFunction computeTile;
+};
+
+#define COMPILED_SEQUENCE(s) { s, ComputeLyapunovTile<SequenceBits(s), SequenceLength(s)> }
+
+static const CompiledSequence compiledSequences[] = {
+	COMPILED_SEQUENCE("AB"),
+	COMPILED_SEQUENCE("AABB"),
+	COMPILED_SEQUENCE("AABAB"),
+	COMPILED_SEQUENCE("BBABA"),
+	COMPILED_SEQUENCE("BBBBBBAAAAAA"),
+};
+
+/** Parses a valid sequence into a table. */
+static LyapunovSequence ParseSequence(const char* text) {
+	LyapunovSequence sequence;
+	for (; text[sequence.length]; sequence.length++) sequence.isB[sequence.length] = toupper((unsigned char)text[sequence.length]) == 'B';
+	return sequence;
+}
+
+/** Compiled kernel of a sequence, nullptr if it has none. */
+static LyapunovTileFunction FindCompiledKernel(const LyapunovSequence& sequence) {
+	for (const CompiledSequence& compiled : compiledSequences) {
+		LyapunovSequence candidate = ParseSequence(compiled.sequence);
+		if (candidate.length == sequence.length && std::equal(candidate.isB, candidate.isB + candidate.length, sequence.isB)) return compiled.computeTile;
+	}
+	return nullptr;
+}
+
+bool IsValidSequence(const char* sequence) {
+	size_t length = strlen(sequence);
+	if (length == 0 || length > LYAPUNOV_MAX_SEQUENCE) return false;
+	for (size_t k = 0; k < length; k++)
+		if (toupper((unsigned char)sequence[k]) != 'A' && toupper((unsigned char)sequence[k]) != 'B') return false;
+	return true;
+}
+
+bool HasCompiledKernel(const char* sequence) {
+	return IsValidSequence(sequence) && FindCompiledKernel(ParseSequence(sequence)) != nullptr;
+}
+
+void ComputeLyapunov(const View& view, uint width, uint height, const LyapunovSettings& settings, float* exponents) {
+	LyapunovSequence sequence = ParseSequence(settings.sequence);
+	LyapunovTileFunction computeTile = settings.forceTable ? nullptr : FindCompiledKernel(sequence);
+	if (!computeTile) computeTile = ComputeLyapunovTile<0, 0>;
+	// Starting from x = 0.5 the first derivative is 0, at least one sequence of warm-up skips it.
+	int warmupPeriods = std::max((settings.warmup + sequence.length - 1) / sequence.length, 1);
+	int periods = std::max((settings.iterations + sequence.length - 1) / sequence.length, 1);
+	ForEachTile(width, height, [&](int, uint x0, uint y0, uint x1, uint y1) {
+		computeTile(view, width, height, sequence, warmupPeriods, periods, x0, y0, x1, y1, exponents);
+	});
+}
+
+void ShadeLyapunov(const float* exponents, size_t pixels, Color* colors) {
+#pragma omp parallel for
+	for (long long p = 0; p < (long long)pixels; p++) {
+		float exponent = exponents[p];
+		if (exponent < 0.0f) {
+			float t = 1.0f - std::exp(2.0f * exponent);
+			colors[p] = Color(t, 0.85f * t, 0.2f * t);
+		}
+		else {
+			// Also where the map diverged and the exponent is not a number.
+			float t = exponent == exponent ? 1.0f - std::exp(-4.0f * exponent) : 1.0f;
+			colors[p] = Color(0.05f * t, 0.25f * t, 0.8f * t);
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "Mandelbrot.h"
+
+/* Longest A/B sequence. */
+#define LYAPUNOV_MAX_SEQUENCE 64
+
+/* Settings of the Lyapunov renderer. */
+struct LyapunovSettings {
+	/* Sequence of A and B, every step of the logistic map uses the rate a (the x coordinate) at A and b (the y coordinate) at B. */
+	char sequence[LYAPUNOV_MAX_SEQUENCE + 1] = "AB";
+	/* Steps before the exponent is accumulated, rounded up to whole sequences. */
+	int warmup = 64;
+	/* Steps the exponent is averaged over, rounded up to whole sequences. */
+	int iterations = 512;
+	/* Use the table-driven kernel even if the sequence has a compiled one. */
+	bool forceTable = false;
+};
+
+/** Whether a sequence consists of 1 to LYAPUNOV_MAX_SEQUENCE letters A and B, in either case. */
+bool IsValidSequence(const char* sequence);
+/** Whether a sequence has a kernel compiled for it, other sequences run the table-driven kernel. */
+bool HasCompiledKernel(const char* sequence);
+
+/** Computes the Lyapunov exponent of the logistic map for every pixel, tiles are distributed over all threads. Short
+* common sequences have kernels with the sequence unrolled at compile time, other sequences look it up in a table.
+* The logarithm of the product of the derivatives is taken once per pixel, the product is kept in range by moving its
+* exponent bits into a sum once per sequence.
+* @param[in] view				Region of the (a, b) plane.
+* @param[in] width				Image width.
+* @param[in] height				Image height.
+* @param[in] settings			Sequence and number of steps, the sequence must be valid.
+* @param[out] exponents			Lyapunov exponent per pixel, negative where the map is stable. Of size width * height.
+*/
+void ComputeLyapunov(const View& view, uint width, uint height, const LyapunovSettings& settings, float* exponents);
+
+/** Colors the pixels by their exponent, stable pixels yellow and chaotic pixels blue, both brighter further from zero.
+* @param[in] exponents			Lyapunov exponent per pixel.
+* @param[in] pixels				Number of pixels.
+* @param[out] colors			Color per pixel.
+*/
+void ShadeLyapunov(const float* exponents, size_t pixels, Color* colors);
@@ -0,0 +1,62 @@
+#include "Mandelbrot.h"
+#include "FastMath.h"
+#include "tmpl/Trace.h"
+
+int IteratePoint(double cx, double cy, int maxIterations, float* smooth) {
+	const double bailout = smooth ? SMOOTH_BAILOUT : 4.0;
+	double xi = 0.0, yi = 0.0;
+	double xx = 0.0, yy = 0.0;
+	int iteration = 0;
+
+	while (xx + yy <= bailout && iteration < maxIterations) {
+		yi = 2.0 * xi * yi + cy;
+		xi = xx - yy + cx;
+		xx = xi * xi;
+		yy = yi * yi;
+		iteration++;
+	}
+
+	if (iteration >= maxIterations) iteration = -1;
+	if (smooth) *smooth = iteration < 0 ? -1.0f : SmoothIteration(iteration, (float)(xx + yy));
+	return iteration;
+}
+
+void ComputeTile(const View& view, uint width, uint height, int maxIterations, uint x0, uint y0, uint x1, uint y1, int* iterations, float* smooth) {
+	const double bailout = smooth ? SMOOTH_BAILOUT : 4.0;
+	// |z|^2 at escape of a run of at most TILE_SIZE pixels.
+	float escapeRadius[TILE_SIZE];
+
+	for (uint y = y0; y < y1; y++)
+		for (uint xs = x0; xs < x1; xs += TILE_SIZE) {
+			uint xe = xs + TILE_SIZE < x1 ? xs + TILE_SIZE : x1;
+
+			for (uint x = xs; x < xe; x++) {
+				double cx = view.centerX + ((double)x / (double)width - 0.5) * 2.0 * view.zoom;
+				double cy = view.centerY + ((double)y / (double)height - 0.5) * 2.0 * view.zoom;
+
+				double xi = 0.0, yi = 0.0;
+				double xx = 0.0, yy = 0.0;
+				int iteration = 0;
+
+				while (xx + yy <= bailout && iteration < maxIterations) {
+					yi = 2.0 * xi * yi + cy;
+					xi = xx - yy + cx;
+					xx = xi * xi;
+					yy = yi * yi;
+					iteration++;
+				}
+
+				iterations[x + y * width] = iteration >= maxIterations ? -1 : iteration;
+				escapeRadius[x - xs] = (float)(xx + yy);
+			}
+
+			// Separate pass over the run so the logarithms run on eight pixels at a time.
+			if (smooth) SmoothIterations(iterations + xs + y * width, escapeRadius, (int)(xe - xs), 1.0f, smooth + xs + y * width);
+		}
+}
+
+void ComputeIterations(const View& view, uint width, uint height, int maxIterations, int* iterations, float* smooth) {
+	ForEachTile(width, height, [&](int, uint x0, uint y0, uint x1, uint y1) {
+		ComputeTile(view, width, height, maxIterations, x0, y0, x1, y1, iterations, smooth);
+	});
+}
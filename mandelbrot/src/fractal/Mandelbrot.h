@@ -0,0 +1,77 @@
+#pragma once
+#include "tmpl/incl.h"
+#include "tmpl/Trace.h"
+
+/* Width and height of the tiles the image is divided in for multi-threading. */
+#define TILE_SIZE 32
+
+/* Region of the complex plane that is rendered. */
+struct View {
+	/* Center of the view. */
+	double centerX, centerY;
+	/* Half the extent of the view in both directions. The view is stretched to the aspect ratio of the image. */
+	double zoom;
+};
+
+/** Number of tiles ForEachTile divides an image in. */
+inline int GetTileCount(uint width, uint height) {
+	return (int)(((width + TILE_SIZE - 1) / TILE_SIZE) * ((height + TILE_SIZE - 1) / TILE_SIZE));
+}
+
+/** Distributes the tiles of an image over all threads, the tile scheduler of every CPU renderer. Tiles near the set take
+* far longer than others, they are handed out one by one.
+* @param[in] width				Image width.
+* @param[in] height				Image height.
+* @param[in] computeTile		Called as computeTile(tile, x0, y0, x1, y1) for every tile, with the tile index below
+*								GetTileCount and the bottom-right pixel exclusive.
+*/
+template <typename Function> void ForEachTile(uint width, uint height, const Function& computeTile) {
+	int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	int tiles = GetTileCount(width, height);
+
+#pragma omp parallel
+	{
+#pragma omp for schedule(dynamic, 1) nowait
+		for (int tile = 0; tile < tiles; tile++) {
+			TRACE_SCOPE_ARG("cpu", "tile", tile);
+			uint x0 = (tile % tilesX) * TILE_SIZE, y0 = (tile / tilesX) * TILE_SIZE;
+			uint x1 = x0 + TILE_SIZE < width ? x0 + TILE_SIZE : width;
+			uint y1 = y0 + TILE_SIZE < height ? y0 + TILE_SIZE : height;
+			computeTile(tile, x0, y0, x1, y1);
+		}
+
+		// Time threads spend idle until the last tile is done.
+		TRACE_SCOPE("cpu", "wait");
+#pragma omp barrier
+	}
+}
+
+/** Computes the iterations of a single point of the complex plane, for sampling at positions between pixel centers.
+* @param[in] cx, cy				Point of the complex plane.
+* @param[in] maxIterations		Maximum number of iterations.
+* @param[out] smooth			Optional continuous iteration count, -1 inside the set. Computing it raises the bailout radius.
+* @returns						Iteration count, -1 inside the set.
+*/
+int IteratePoint(double cx, double cy, int maxIterations, float* smooth = nullptr);
+
+/** Computes the iterations of a rectangular part of the image on the calling thread.
+* @param[in] view				Region of the complex plane.
+* @param[in] width				Image width.
+* @param[in] height				Image height.
+* @param[in] maxIterations		Maximum number of iterations.
+* @param[in] x0, y0				Top-left pixel of the tile (inclusive).
+* @param[in] x1, y1				Bottom-right pixel of the tile (exclusive).
+* @param[out] iterations		Iteration count per pixel of the image, -1 inside the set. Of size width * height.
+* @param[out] smooth			Optional continuous iteration count per pixel, -1 inside the set. Computing it raises the bailout radius.
+*/
+void ComputeTile(const View& view, uint width, uint height, int maxIterations, uint x0, uint y0, uint x1, uint y1, int* iterations, float* smooth = nullptr);
+
+/** Computes the iterations of the whole image, tiles are distributed over all threads.
+* @param[in] view				Region of the complex plane.
+* @param[in] width				Image width.
+* @param[in] height				Image height.
+* @param[in] maxIterations		Maximum number of iterations.
+* @param[out] iterations		Iteration count per pixel, -1 inside the set. Of size width * height.
+* @param[out] smooth			Optional continuous iteration count per pixel, -1 inside the set. Computing it raises the bailout radius.
+*/
+void ComputeIterations(const View& view, uint width, uint height, int maxIterations, int* iterations, float* smooth = nullptr);
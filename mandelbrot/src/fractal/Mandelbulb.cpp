@@ -0,0 +1,288 @@
+#include "Mandelbulb.h"
+#include "FastMath.h"
+#include "tmpl/Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/* Squared bailout radius of the distance estimator. */
+#define BULB_BAILOUT 256.0f
+
+static inline float Sqrt(float a) { return std::sqrt(a); }
+static inline float Max(float a, float b) { return a > b ? a : b; }
+
+#ifdef __AVX2__
+/* Eight floats in an AVX register, so one iteration serves both a single ray and a packet of rays. */
+struct float8 {
+	__m256 v;
+	float8() : v(_mm256_setzero_ps()) {}
+	float8(__m256 v) : v(v) {}
+	float8(float s) : v(_mm256_set1_ps(s)) {}
+};
+static inline float8 operator+(float8 a, float8 b) { return _mm256_add_ps(a.v, b.v); }
+static inline float8 operator-(float8 a, float8 b) { return _mm256_sub_ps(a.v, b.v); }
+static inline float8 operator*(float8 a, float8 b) { return _mm256_mul_ps(a.v, b.v); }
+static inline float8 operator/(float8 a, float8 b) { return _mm256_div_ps(a.v, b.v); }
+static inline float8 Sqrt(float8 a) { return _mm256_sqrt_ps(a.v); }
+static inline float8 Max(float8 a, float8 b) { return _mm256_max_ps(a.v, b.v); }
+/** Lanes of a where the mask is set, of b elsewhere. */
+static inline float8 Select(__m256 mask, float8 a, float8 b) { return _mm256_blendv_ps(b.v, a.v, mask); }
+#endif
+
+/** One iteration w = w^8 + c of the Mandelbulb and of the running derivative dz, given m = |w|^2. T is float or float8. */
+template <typename T> static inline void BulbStep(T& x, T& y, T& z, T& dz, const T& m, const T& cx, const T& cy, const T& cz) {
+	T m2 = m * m;
+	dz = T(8.0f) * Sqrt(m2 * m2 * m2 * m) * dz + T(1.0f);
+
+	T x2 = x * x, x4 = x2 * x2;
+	T y2 = y * y, y4 = y2 * y2;
+	T z2 = z * z, z4 = z2 * z2;
+	// Stay off the vertical axis, where the angle around it is undefined.
+	T k3 = Max(x2 + z2, T(1e-5f));
+	T k2 = T(1.0f) / Sqrt(k3 * k3 * k3 * k3 * k3 * k3 * k3);
+	T k1 = x4 + y4 + z4 - T(6.0f) * y2 * z2 - T(6.0f) * x2 * y2 + T(2.0f) * z2 * x2;
+	T k4 = x2 - y2 + z2;
+
+	T nx = cx + T(64.0f) * x * y * z * (x2 - z2) * k4 * (x4 - T(6.0f) * x2 * z2 + z4) * k1 * k2;
+	T ny = cy + T(-16.0f) * y2 * k3 * k4 * k4 + k1 * k1;
+	T nz = cz + T(-8.0f) * y * k4 * (x4 * x4 - T(28.0f) * x4 * x2 * z2 + T(70.0f) * x4 * z4 - T(28.0f) * x2 * z2 * z4 + z4 * z4) * k1 * k2;
+	x = nx, y = ny, z = nz;
+}
+
+float MandelbulbDistance(glm::vec3 p, int iterations) {
+	float x = p.x, y = p.y, z = p.z, dz = 1.0f;
+	float m = x * x + y * y + z * z;
+	for (int i = 0; i < iterations; i++) {
+		BulbStep(x, y, z, dz, m, p.x, p.y, p.z);
+		m = x * x + y * y + z * z;
+		if (m > BULB_BAILOUT) break;
+	}
+	// 0.5 * ln(r) * r / dr with r = sqrt(m).
+	return 0.25f * 0.6931472f * FastLog2(m) * std::sqrt(m) / dz;
+}
+
+#ifdef __AVX2__
+/** MandelbulbDistance of eight points, escaped lanes are frozen by a mask. */
+static inline float8 MandelbulbDistance(float8 px, float8 py, float8 pz, int iterations) {
+	float8 x = px, y = py, z = pz, dz = 1.0f;
+	float8 m = x * x + y * y + z * z;
+	__m256 active = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+	for (int i = 0; i < iterations; i++) {
+		float8 nx = x, ny = y, nz = z, ndz = dz;
+		BulbStep(nx, ny, nz, ndz, m, px, py, pz);
+		x = Select(active, nx, x), y = Select(active, ny, y), z = Select(active, nz, z), dz = Select(active, ndz, dz);
+		m = x * x + y * y + z * z;
+		active = _mm256_and_ps(active, _mm256_cmp_ps(m.v, _mm256_set1_ps(BULB_BAILOUT), _CMP_LE_OQ));
+		if (_mm256_movemask_ps(active) == 0) break;
+	}
+	return float8(0.25f * 0.6931472f) * float8(FastLog2(m.v)) * Sqrt(m) / dz;
+}
+#endif
+
+/** Intersects a ray with the bounding sphere.
+* @param[out] tNear, tFar		Distances along the ray where it enters and leaves the sphere, tNear is at least 0.
+* @returns						False if the ray misses the sphere.
+*/
+static inline bool IntersectBound(glm::vec3 origin, glm::vec3 dir, float& tNear, float& tFar) {
+	float b = glm::dot(origin, dir), c = glm::dot(origin, origin) - MANDELBULB_BOUND * MANDELBULB_BOUND;
+	float discriminant = b * b - c;
+	if (discriminant < 0.0f) return false;
+	float s = std::sqrt(discriminant);
+	tNear = std::max(-b - s, 0.0f), tFar = -b + s;
+	return tFar > 0.0f;
+}
+
+/** Normal of the surface at a point, the gradient of the distance estimate from four samples on a tetrahedron. */
+static glm::vec3 BulbNormal(glm::vec3 p, float h, int iterations) {
+	const glm::vec3 k0(1.0f, -1.0f, -1.0f), k1(-1.0f, -1.0f, 1.0f), k2(-1.0f, 1.0f, -1.0f), k3(1.0f, 1.0f, 1.0f);
+	glm::vec3 n = k0 * MandelbulbDistance(p + h * k0, iterations) + k1 * MandelbulbDistance(p + h * k1, iterations)
+		+ k2 * MandelbulbDistance(p + h * k2, iterations) + k3 * MandelbulbDistance(p + h * k3, iterations);
+	float length = glm::length(n);
+	return length > 0.0f ? n / length : -glm::vec3(0.0f, 0.0f, 1.0f);
+}
+
+static inline Color ShadeBackground(glm::vec3 dir) {
+	float t = 0.5f + 0.5f * dir.y;
+	return Color(0.04f + 0.08f * t, 0.05f + 0.12f * t, 0.08f + 0.22f * t);
+}
+
+/** Shades a hit with a diffuse and specular light. Rays that needed many steps pass close to other parts of the surface,
+* their step count darkens the hit as a cheap ambient occlusion.
+*/
+static inline Color ShadeHit(glm::vec3 normal, glm::vec3 dir, float steps, int maxSteps) {
+	const glm::vec3 light = glm::normalize(glm::vec3(0.6f, 0.8f, 0.4f));
+	float diffuse = std::max(glm::dot(normal, light), 0.0f);
+	float specular = std::pow(std::max(glm::dot(normal, glm::normalize(light - dir)), 0.0f), 32.0f);
+	float occlusion = 1.0f - std::min(steps / maxSteps, 1.0f);
+
+	glm::vec3 base = glm::mix(glm::vec3(0.85f, 0.55f, 0.3f), glm::vec3(0.35f, 0.55f, 0.85f), 0.5f + 0.5f * normal.y);
+	glm::vec3 color = base * (0.15f + 0.85f * diffuse) * occlusion + glm::vec3(0.3f * specular * occlusion);
+	return Color(color.r, color.g, color.b);
+}
+
+/** Marches and shades a single ray.
+* @param[out] steps				Number of distance estimates.
+* @returns						True if the ray hit the surface.
+*/
+static bool MarchRay(glm::vec3 origin, glm::vec3 dir, float pixelAngle, const MandelbulbSettings& settings, Color& color, int& steps) {
+	float t, tFar;
+	steps = 0;
+	color = ShadeBackground(dir);
+	if (!IntersectBound(origin, dir, t, tFar)) return false;
+
+	const float footprint = pixelAngle * settings.detail;
+	float epsilon = 0.0f;
+	while (steps < settings.maxSteps) {
+		float d = MandelbulbDistance(origin + t * dir, settings.iterations);
+		steps++;
+		epsilon = t * footprint;
+		if (d < epsilon) break;
+		t += d;
+		if (t > tFar) return false;
+	}
+
+	// Rays that run out of steps graze the surface, they count as hits.
+	glm::vec3 p = origin + t * dir;
+	color = ShadeHit(BulbNormal(p, std::max(epsilon, 1e-5f), settings.iterations), dir, (float)steps, settings.maxSteps);
+	return true;
+}
+
+#ifdef __AVX2__
+/** Marches and shades a packet of eight rays, a 4 by 2 block of pixels. The packet stops when all rays stopped.
+* @param[out] steps				Number of distance estimates, summed over the rays.
+* @returns						Number of rays that hit the surface.
+*/
+static int MarchPacket(glm::vec3 origin, const glm::vec3 dirs[8], float pixelAngle, const MandelbulbSettings& settings, Color colors[8], int& steps) {
+	alignas(32) float enter[8], leave[8], dx[8], dy[8], dz[8];
+	int live = 0;
+	for (int lane = 0; lane < 8; lane++) {
+		dx[lane] = dirs[lane].x, dy[lane] = dirs[lane].y, dz[lane] = dirs[lane].z;
+		enter[lane] = 0.0f, leave[lane] = -1.0f;
+		if (IntersectBound(origin, dirs[lane], enter[lane], leave[lane])) live |= 1 << lane;
+		colors[lane] = ShadeBackground(dirs[lane]);
+	}
+	steps = 0;
+	if (live == 0) return 0;
+
+	const float8 ox = origin.x, oy = origin.y, oz = origin.z;
+	const float8 rx = _mm256_load_ps(dx), ry = _mm256_load_ps(dy), rz = _mm256_load_ps(dz);
+	const float8 tFar = _mm256_load_ps(leave), footprint = pixelAngle * settings.detail;
+	float8 t = _mm256_load_ps(enter), laneSteps = 0.0f, epsilon = 0.0f;
+	__m256 active = _mm256_cmp_ps(tFar.v, _mm256_setzero_ps(), _CMP_GT_OQ), hit = _mm256_setzero_ps();
+
+	for (int s = 0; s < settings.maxSteps; s++) {
+		laneSteps = laneSteps + float8(_mm256_and_ps(active, _mm256_set1_ps(1.0f)));
+		float8 d = MandelbulbDistance(ox + t * rx, oy + t * ry, oz + t * rz, settings.iterations);
+		epsilon = Select(active, t * footprint, epsilon);
+		__m256 close = _mm256_and_ps(active, _mm256_cmp_ps(d.v, epsilon.v, _CMP_LT_OQ));
+		hit = _mm256_or_ps(hit, close);
+		active = _mm256_andnot_ps(close, active);
+		t = Select(active, t + d, t);
+		active = _mm256_and_ps(active, _mm256_cmp_ps(t.v, tFar.v, _CMP_LE_OQ));
+		if (_mm256_movemask_ps(active) == 0) break;
+	}
+	// Rays that run out of steps graze the surface, they count as hits.
+	hit = _mm256_or_ps(hit, active);
+
+	alignas(32) float hitT[8], hitEpsilon[8], hitSteps[8];
+	_mm256_store_ps(hitT, t.v);
+	_mm256_store_ps(hitEpsilon, epsilon.v);
+	_mm256_store_ps(hitSteps, laneSteps.v);
+	for (int lane = 0; lane < 8; lane++) steps += (int)hitSteps[lane];
+
+	int hitMask = _mm256_movemask_ps(hit);
+	if (hitMask == 0) return 0;
+
+	// Normals of the whole packet from four packed distance estimates around the hit points.
+	const float8 px = ox + t * rx, py = oy + t * ry, pz = oz + t * rz, h = Max(epsilon, float8(1e-5f));
+	float8 d0 = MandelbulbDistance(px + h, py - h, pz - h, settings.iterations);
+	float8 d1 = MandelbulbDistance(px - h, py - h, pz + h, settings.iterations);
+	float8 d2 = MandelbulbDistance(px - h, py + h, pz - h, settings.iterations);
+	float8 d3 = MandelbulbDistance(px + h, py + h, pz + h, settings.iterations);
+	alignas(32) float nx[8], ny[8], nz[8];
+	_mm256_store_ps(nx, (d0 - d1 - d2 + d3).v);
+	_mm256_store_ps(ny, (d2 + d3 - d0 - d1).v);
+	_mm256_store_ps(nz, (d1 + d3 - d0 - d2).v);
+
+	int hits = 0;
+	for (int lane = 0; lane < 8; lane++) {
+		if (!(hitMask & (1 << lane))) continue;
+		glm::vec3 n(nx[lane], ny[lane], nz[lane]);
+		float length = glm::length(n);
+		colors[lane] = ShadeHit(length > 0.0f ? n / length : -dirs[lane], dirs[lane], hitSteps[lane], settings.maxSteps);
+		hits++;
+	}
+	return hits;
+}
+#endif
+
+/** Whether all rays through a tile miss the bounding sphere: the rays lie in the cone around the center ray that holds
+* the corner rays, the sphere lies in the cone around the direction of its center given by its angular radius.
+*/
+static bool CullTile(const Camera& camera, uint width, uint height, uint x0, uint y0, uint x1, uint y1) {
+	glm::vec3 toCenter = -camera.GetPosition();
+	float distance = glm::length(toCenter);
+	if (distance <= MANDELBULB_BOUND) return false;
+
+	glm::vec3 axis = camera.GetRayDirection(0.5f * (x0 + x1), 0.5f * (y0 + y1), width, height);
+	float cone = 1.0f;
+	float corners[4][2] = { { (float)x0, (float)y0 }, { (float)x1, (float)y0 }, { (float)x0, (float)y1 }, { (float)x1, (float)y1 } };
+	for (auto& corner : corners) cone = std::min(cone, glm::dot(axis, camera.GetRayDirection(corner[0], corner[1], width, height)));
+
+	float angle = std::acos(std::min(glm::dot(axis, toCenter / distance), 1.0f));
+	return angle > std::acos(cone) + std::asin(MANDELBULB_BOUND / distance);
+}
+
+void RenderMandelbulb(const Camera& camera, uint width, uint height, const MandelbulbSettings& settings, Color* colors, MandelbulbStats* stats) {
+	const glm::vec3 origin = camera.GetPosition();
+	const float pixelAngle = camera.GetPixelAngle(height);
+	// Counts per tile, summed after all tiles are done.
+	struct TileStats {
+		long long hits = 0, steps = 0, marched = 0, culled = 0;
+	};
+	std::vector<TileStats> tiles(GetTileCount(width, height));
+
+	ForEachTile(width, height, [&](int tile, uint x0, uint y0, uint x1, uint y1) {
+		TileStats& tileStats = tiles[tile];
+		// Early termination of the whole tile, it only shows the background.
+		if (CullTile(camera, width, height, x0, y0, x1, y1)) {
+			for (uint y = y0; y < y1; y++)
+				for (uint x = x0; x < x1; x++) colors[x + y * width] = ShadeBackground(camera.GetRayDirection(x + 0.5f, y + 0.5f, width, height));
+			tileStats.culled = 1;
+			return;
+		}
+
+		for (uint y = y0; y < y1; y += 2)
+			for (uint x = x0; x < x1; x += 4) {
+#ifdef __AVX2__
+				if (x + 4 <= x1 && y + 2 <= y1) {
+					glm::vec3 dirs[8];
+					Color packet[8];
+					for (int lane = 0; lane < 8; lane++)
+						dirs[lane] = camera.GetRayDirection(x + (lane & 3) + 0.5f, y + (lane >> 2) + 0.5f, width, height);
+					int packetSteps;
+					tileStats.hits += MarchPacket(origin, dirs, pixelAngle, settings, packet, packetSteps);
+					tileStats.steps += packetSteps, tileStats.marched += 8;
+					for (int lane = 0; lane < 8; lane++) colors[x + (lane & 3) + (y + (lane >> 2)) * width] = packet[lane];
+					continue;
+				}
+#endif
+				for (uint py = y; py < y + 2 && py < y1; py++)
+					for (uint px = x; px < x + 4 && px < x1; px++) {
+						int raySteps;
+						glm::vec3 dir = camera.GetRayDirection(px + 0.5f, py + 0.5f, width, height);
+						tileStats.hits += MarchRay(origin, dir, pixelAngle, settings, colors[px + py * width], raySteps);
+						tileStats.steps += raySteps, tileStats.marched++;
+					}
+			}
+	});
+
+	if (stats) {
+		long long hits = 0, steps = 0, marched = 0, culled = 0;
+		for (const TileStats& tileStats : tiles)
+			hits += tileStats.hits, steps += tileStats.steps, marched += tileStats.marched, culled += tileStats.culled;
+		stats->hitFraction = (float)hits / (width * height);
+		stats->averageSteps = marched ? (float)steps / marched : 0.0f;
+		stats->culledTiles = (float)culled / tiles.size();
+	}
+}
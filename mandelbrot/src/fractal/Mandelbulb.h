@@ -0,0 +1,46 @@
+#pragma once
+#include "Mandelbrot.h"
+#include "tmpl/Camera.h"
+
+/* Radius of the sphere the Mandelbulb lies in, rays that miss it are not marched. */
+#define MANDELBULB_BOUND 1.25f
+
+/* Settings of the Mandelbulb ray-marcher. */
+struct MandelbulbSettings {
+	/* Iterations of the distance estimator, more iterations give finer detail. */
+	int iterations = 6;
+	/* Maximum number of marching steps per ray. */
+	int maxSteps = 160;
+	/* Rays stop this many pixel footprints from the surface, larger values give less detail in fewer steps. */
+	float detail = 1.0f;
+};
+
+/* Statistics of the last frame. */
+struct MandelbulbStats {
+	/* Fraction of the pixels whose ray hit the surface. */
+	float hitFraction = 0.0f;
+	/* Average number of distance estimates per marched ray. */
+	float averageSteps = 0.0f;
+	/* Fraction of the tiles whose rays all miss the bounding sphere. */
+	float culledTiles = 0.0f;
+};
+
+/** Distance estimate of the power 8 Mandelbulb, with the polynomial form of the triplex power so it needs no
+* trigonometry.
+* @param[in] p					Point.
+* @param[in] iterations			Iterations of the estimator.
+* @returns						Lower bound of the distance to the surface.
+*/
+float MandelbulbDistance(glm::vec3 p, int iterations);
+
+/** Ray-marches the Mandelbulb, tiles are distributed over all threads. Rays are marched in packets of eight with AVX2,
+* a packet stops when all its rays hit or left the bounding sphere. Tiles whose rays all miss the bounding sphere are
+* not marched at all.
+* @param[in] camera				Camera the image is rendered from.
+* @param[in] width				Image width.
+* @param[in] height				Image height.
+* @param[in] settings			Detail and step limits.
+* @param[out] colors			Shaded color per pixel, row 0 is the bottom row.
+* @param[out] stats				Optional statistics of the frame.
+*/
+void RenderMandelbulb(const Camera& camera, uint width, uint height, const MandelbulbSettings& settings, Color* colors, MandelbulbStats* stats = nullptr);
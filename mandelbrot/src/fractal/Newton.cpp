@@ -0,0 +1,231 @@
+#include "Newton.h"
+#include "Formula.h"
+#include "tmpl/Trace.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+
+NewtonPolynomial::NewtonPolynomial() {
+	Parse("z^3 - 1");
+}
+
+bool NewtonPolynomial::Parse(const char* text) {
+	double coefficients[NEWTON_MAX_DEGREE + 1] = {};
+	const char* c = text;
+	auto skipSpaces = [&]() { while (*c == ' ' || *c == '\t') c++; };
+	auto fail = [&]() {
+		std::cerr << "Could not parse polynomial " << text << std::endl;
+		return false;
+	};
+
+	skipSpaces();
+	for (bool first = true; *c; first = false) {
+		double sign = 1.0;
+		if (*c == '+' || *c == '-') sign = *c++ == '-' ? -1.0 : 1.0;
+		else if (!first) return fail();
+		skipSpaces();
+
+		// A term is a coefficient, z or both, z optionally to a power.
+		double coefficient = 1.0;
+		bool number = isdigit((unsigned char)*c) || *c == '.';
+		if (number) {
+			char* end;
+			coefficient = strtod(c, &end);
+			c = end;
+			skipSpaces();
+			if (*c == '*') c++, skipSpaces();
+		}
+		long power = 0;
+		if (*c == 'z') {
+			c++, power = 1;
+			skipSpaces();
+			if (*c == '^') {
+				c++;
+				skipSpaces();
+				if (!isdigit((unsigned char)*c)) return fail();
+				char* end;
+				power = strtol(c, &end, 10);
+				c = end;
+			}
+		}
+		else if (!number) return fail();
+
+		if (power > NEWTON_MAX_DEGREE) {
+			std::cerr << "Polynomial " << text << " is of a degree above " << NEWTON_MAX_DEGREE << std::endl;
+			return false;
+		}
+		coefficients[power] += sign * coefficient;
+		skipSpaces();
+	}
+
+	int degree = NEWTON_MAX_DEGREE;
+	while (degree > 0 && coefficients[degree] == 0.0) degree--;
+	if (degree < 1) return fail();
+
+	m_Degree = degree;
+	std::copy(coefficients, coefficients + NEWTON_MAX_DEGREE + 1, m_Coefficients);
+	m_Text = text;
+	FindRoots();
+	return true;
+}
+
+void NewtonPolynomial::FindRoots() {
+	typedef std::complex<double> complex;
+	auto evaluate = [this](complex z) {
+		complex p = m_Coefficients[m_Degree];
+		for (int k = m_Degree - 1; k >= 0; k--) p = p * z + m_Coefficients[k];
+		return p;
+	};
+
+	// Starting values on a spiral, off the real axis so conjugate roots separate.
+	complex roots[NEWTON_MAX_DEGREE];
+	for (int k = 0; k < m_Degree; k++) roots[k] = std::pow(complex(0.4, 0.9), k);
+
+	for (int iteration = 0; iteration < 1000; iteration++) {
+		double change = 0.0;
+		for (int k = 0; k < m_Degree; k++) {
+			complex denominator = m_Coefficients[m_Degree];
+			for (int j = 0; j < m_Degree; j++)
+				if (j != k) denominator *= roots[k] - roots[j];
+			complex delta = evaluate(roots[k]) / denominator;
+			roots[k] -= delta;
+			change = std::max(change, std::abs(delta));
+		}
+		if (change < 1e-14) break;
+	}
+
+	for (int k = 0; k < m_Degree; k++) m_RootsRe[k] = roots[k].real(), m_RootsIm[k] = roots[k].imag();
+}
+
+/** One Newton step z -= p(z) / p'(z), with p and p' evaluated together by Horner's scheme on the real coefficients a.
+* The loop is unrolled by the degree into a fixed sequence of multiply-adds. T is double or double4.
+*/
+template <int Degree, typename T> static inline void NewtonStep(T& x, T& y, const T* a) {
+	T pr = a[Degree], pi = T(0.0), dr = T(0.0), di = T(0.0);
+	for (int k = Degree - 1; k >= 0; k--) {
+		// p' = p' * z + p
+		T t = dr * x - di * y + pr;
+		di = dr * y + di * x + pi;
+		dr = t;
+		// p = p * z + a[k]
+		t = pr * x - pi * y + a[k];
+		pi = pr * y + pi * x;
+		pr = t;
+	}
+	// z -= p * conj(p') / |p'|^2
+	T inverse = T(1.0) / (dr * dr + di * di);
+	x = x - (pr * dr + pi * di) * inverse;
+	y = y - (pi * dr - pr * di) * inverse;
+}
+
+/** Newton iteration of a single pixel, for the pixels of a row that do not fill a vector.
+* @param[out] root				Index of the root it converged to, -1 if it did not converge.
+* @returns						Newton steps until it converged, -1 if it did not converge.
+*/
+template <int Degree> static inline int IterateNewton(double x, double y, int maxIterations, const double* a, const double* rootsRe, const double* rootsIm, int& root) {
+	for (int iteration = 0; iteration < maxIterations; iteration++) {
+		for (int k = 0; k < Degree; k++) {
+			double dx = x - rootsRe[k], dy = y - rootsIm[k];
+			if (dx * dx + dy * dy < NEWTON_TOLERANCE) {
+				root = k;
+				return iteration;
+			}
+		}
+		NewtonStep<Degree>(x, y, a);
+	}
+	root = -1;
+	return -1;
+}
+
+/** Computes the Newton basins of a rectangular part of the image for one degree, four pixels at a time with AVX2. */
+template <int Degree> static void ComputeNewtonTile(const View& view, uint width, uint height, int maxIterations, const NewtonPolynomial& polynomial,
+	uint x0, uint y0, uint x1, uint y1, int* iterations, int* roots) {
+	double a[Degree + 1], rootsRe[Degree], rootsIm[Degree];
+	for (int k = 0; k <= Degree; k++) a[k] = polynomial.GetCoefficient(k);
+	for (int k = 0; k < Degree; k++) rootsRe[k] = polynomial.GetRootRe(k), rootsIm[k] = polynomial.GetRootIm(k);
+#ifdef __AVX2__
+	double4 va[Degree + 1], vRootsRe[Degree], vRootsIm[Degree];
+	for (int k = 0; k <= Degree; k++) va[k] = a[k];
+	for (int k = 0; k < Degree; k++) vRootsRe[k] = rootsRe[k], vRootsIm[k] = rootsIm[k];
+#endif
+
+	for (uint y = y0; y < y1; y++) {
+		double py = view.centerY + ((double)y / (double)height - 0.5) * 2.0 * view.zoom;
+		uint x = x0;
+
+#ifdef __AVX2__
+		for (; x + 4 <= x1; x += 4) {
+			double4 zx = _mm256_setr_pd(
+				view.centerX + ((double)(x + 0) / (double)width - 0.5) * 2.0 * view.zoom,
+				view.centerX + ((double)(x + 1) / (double)width - 0.5) * 2.0 * view.zoom,
+				view.centerX + ((double)(x + 2) / (double)width - 0.5) * 2.0 * view.zoom,
+				view.centerX + ((double)(x + 3) / (double)width - 0.5) * 2.0 * view.zoom);
+			double4 zy = py;
+
+			// Lanes keep stepping after they converged, their count and root are frozen by the mask.
+			const __m256d tolerance = _mm256_set1_pd(NEWTON_TOLERANCE), one = _mm256_set1_pd(1.0);
+			__m256d active = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+			__m256d count = _mm256_setzero_pd(), root = _mm256_set1_pd(-1.0);
+			for (int iteration = 0; iteration < maxIterations; iteration++) {
+				for (int k = 0; k < Degree; k++) {
+					double4 dx = zx - vRootsRe[k], dy = zy - vRootsIm[k];
+					__m256d converged = _mm256_and_pd(active, _mm256_cmp_pd((dx * dx + dy * dy).v, tolerance, _CMP_LT_OQ));
+					root = _mm256_blendv_pd(root, _mm256_set1_pd((double)k), converged);
+					active = _mm256_andnot_pd(converged, active);
+				}
+				if (_mm256_movemask_pd(active) == 0) break;
+
+				NewtonStep<Degree>(zx, zy, va);
+				count = _mm256_add_pd(count, _mm256_and_pd(active, one));
+			}
+
+			int counts[4], indices[4];
+			_mm_storeu_si128((__m128i*)counts, _mm256_cvtpd_epi32(count));
+			_mm_storeu_si128((__m128i*)indices, _mm256_cvtpd_epi32(root));
+			for (int lane = 0; lane < 4; lane++) {
+				iterations[x + lane + y * width] = indices[lane] < 0 ? -1 : counts[lane];
+				roots[x + lane + y * width] = indices[lane];
+			}
+		}
+#endif
+		for (; x < x1; x++) {
+			double px = view.centerX + ((double)x / (double)width - 0.5) * 2.0 * view.zoom;
+			iterations[x + y * width] = IterateNewton<Degree>(px, py, maxIterations, a, rootsRe, rootsIm, roots[x + y * width]);
+		}
+	}
+}
+
+typedef void (*NewtonTileFunction)(const View&, uint, uint, int, const NewtonPolynomial&, uint, uint, uint, uint, int*, int*);
+
+static const NewtonTileFunction newtonTileFunctions[NEWTON_MAX_DEGREE] = {
+	ComputeNewtonTile<1>, ComputeNewtonTile<2>, ComputeNewtonTile<3>, ComputeNewtonTile<4>,
+	ComputeNewtonTile<5>, ComputeNewtonTile<6>, ComputeNewtonTile<7>, ComputeNewtonTile<8>
+};
+
+void ComputeNewton(const View& view, uint width, uint height, int maxIterations, const NewtonPolynomial& polynomial, int* iterations, int* roots) {
+	NewtonTileFunction computeTile = newtonTileFunctions[polynomial.GetDegree() - 1];
+	ForEachTile(width, height, [&](int, uint x0, uint y0, uint x1, uint y1) {
+		computeTile(view, width, height, maxIterations, polynomial, x0, y0, x1, y1, iterations, roots);
+	});
+}
+
+void ShadeNewton(const int* iterations, const int* roots, size_t pixels, int rootCount, int maxIterations, Color* colors) {
+	// Color per root and step count, the pixels only look it up.
+	std::vector<Color> table((size_t)rootCount * maxIterations);
+	for (int root = 0; root < rootCount; root++) {
+		float hue = (float)root / rootCount * 6.0f;
+		float r = std::min(std::max(std::fabs(hue - 3.0f) - 1.0f, 0.0f), 1.0f);
+		float g = std::min(std::max(2.0f - std::fabs(hue - 2.0f), 0.0f), 1.0f);
+		float b = std::min(std::max(2.0f - std::fabs(hue - 4.0f), 0.0f), 1.0f);
+		for (int iteration = 0; iteration < maxIterations; iteration++) {
+			float brightness = 0.1f + 0.9f * std::pow(0.92f, (float)iteration);
+			table[root * maxIterations + iteration] = Color((0.25f + 0.75f * r) * brightness, (0.25f + 0.75f * g) * brightness, (0.25f + 0.75f * b) * brightness);
+		}
+	}
+
+#pragma omp parallel for
+	for (long long p = 0; p < (long long)pixels; p++)
+		colors[p] = iterations[p] < 0 ? Color(0.0f) : table[roots[p] * maxIterations + iterations[p]];
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "Mandelbrot.h"
+#include <string>
+
+/* Highest degree of a polynomial, every degree up to it has its own compiled kernel. */
+#define NEWTON_MAX_DEGREE 8
+/* Squared distance to a root at which a pixel counts as converged. */
+#define NEWTON_TOLERANCE 1e-6
+
+/** Polynomial with real coefficients whose Newton basins are rendered. Parsing it finds its roots once, the kernels
+* only compare against them.
+*/
+class NewtonPolynomial {
+
+public:
+	/** Creates z^3 - 1. */
+	NewtonPolynomial();
+
+	/** Parses a polynomial in z, e.g. "z^3 - 1" or "z^8 + 15z^4 - 16". Terms are a coefficient, z or both, optionally
+	* to a power. The polynomial is left unchanged if the text can not be parsed.
+	* @param[in] text				Polynomial of degree 1 to NEWTON_MAX_DEGREE.
+	* @returns						False if the text could not be parsed.
+	*/
+	bool Parse(const char* text);
+
+	int GetDegree() const { return m_Degree; }
+	/** Coefficient of z^k. */
+	double GetCoefficient(int k) const { return m_Coefficients[k]; }
+	/** Real and imaginary part of a root, one root per degree. Repeated roots are found more than once. */
+	double GetRootRe(int k) const { return m_RootsRe[k]; }
+	double GetRootIm(int k) const { return m_RootsIm[k]; }
+	const std::string& GetText() const { return m_Text; }
+
+private:
+	int m_Degree = 0;
+	double m_Coefficients[NEWTON_MAX_DEGREE + 1] = {};
+	double m_RootsRe[NEWTON_MAX_DEGREE] = {}, m_RootsIm[NEWTON_MAX_DEGREE] = {};
+	std::string m_Text;
+
+	/** Finds all roots with the Durand-Kerner method. */
+	void FindRoots();
+};
+
+/** Computes the Newton basins of the whole image, tiles are distributed over all threads. The kernel is selected once
+* per call by the degree, within it the evaluation of the polynomial and its derivative is a fixed sequence of
+* multiply-adds on coefficients held in registers, four pixels at a time with AVX2.
+* @param[in] view				Region of the complex plane.
+* @param[in] width				Image width.
+* @param[in] height				Image height.
+* @param[in] maxIterations		Maximum number of Newton steps.
+* @param[in] polynomial			Polynomial and its roots.
+* @param[out] iterations		Newton steps until the pixel came within the tolerance of a root, -1 if it did not converge. Of size width * height.
+* @param[out] roots				Index of the root each pixel converged to, -1 if it did not converge. Of size width * height.
+*/
+void ComputeNewton(const View& view, uint width, uint height, int maxIterations, const NewtonPolynomial& polynomial, int* iterations, int* roots);
+
+/** Colors the pixels by the root they converged to, darker the more steps they needed.
+* @param[in] iterations			Newton steps per pixel, -1 if it did not converge.
+* @param[in] roots				Root index per pixel, -1 if it did not converge.
+* @param[in] pixels				Number of pixels.
+* @param[in] rootCount			Number of roots, each gets its own hue.
+* @param[in] maxIterations		Maximum number of Newton steps.
+* @param[out] colors			Color per pixel.
+*/
+void ShadeNewton(const int* iterations, const int* roots, size_t pixels, int rootCount, int maxIterations, Color* colors);
@@ -0,0 +1,183 @@
+#include "Palette.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/* Number of iterations the classic palette spans before it repeats. */
+#define CLASSIC_PERIOD 128
+
+/** The original coloring of the application, clamped to [0, 1].
+* @param[in] iteration			Number of iterations it took to calculate the Mandelbrot value.
+*/
+static Color ClassicColor(int iteration) {
+	Color color;
+	if (iteration == 0) color = Color(1.0f, 0.0f, 0.0f);
+	else if (iteration < 16) color = Color(16.0f, 0.0f, 16.0f * iteration - 1.0f) / 255.0f;
+	else if (iteration < 32) color = Color(0.0f, 16.0f * (iteration - 16.0f), 16.0f * (32.0f - iteration) - 1.0f) / 255.0f;
+	else if (iteration < 64) color = Color(8.0f * (iteration - 32.0f), 8.0f * (64.0f - iteration) - 1.0f, 0.0f) / 255.0f;
+	else color = Color(255.0f - (iteration - 64.0f) * 4.0f, 0.0f, 0.0f) / 255.0f;
+	return Color(std::max(color.r, 0.0f), std::max(color.g, 0.0f), std::max(color.b, 0.0f));
+}
+
+static Color Lerp(Color a, Color b, float t) {
+	return a * (1.0f - t) + b * t;
+}
+
+Palette::Palette() {
+	SetClassic();
+	SetPeriod(CLASSIC_PERIOD);
+}
+
+void Palette::SetClassic() {
+	m_Table.resize(PALETTE_SIZE + 2);
+	for (int i = 0; i < PALETTE_SIZE; i++) {
+		float iteration = (float)i * CLASSIC_PERIOD / PALETTE_SIZE;
+		int whole = (int)iteration;
+		m_Table[i] = Lerp(ClassicColor(whole), ClassicColor(whole + 1), iteration - (float)whole);
+	}
+	m_Table[PALETTE_SIZE] = m_Table[PALETTE_SIZE + 1] = Color(0.0f, 0.0f, 0.0f);
+	m_Name = "classic";
+}
+
+void Palette::SetStops(const std::vector<PaletteStop>& stops) {
+	m_Table.resize(PALETTE_SIZE + 2);
+	for (int i = 0; i < PALETTE_SIZE; i++) {
+		float position = (float)i / PALETTE_SIZE;
+
+		// The stops wrap around, the last stop blends into the first one.
+		size_t next = 0;
+		while (next < stops.size() && stops[next].position <= position) next++;
+		const PaletteStop& a = next == 0 ? stops.back() : stops[next - 1];
+		const PaletteStop& b = next == stops.size() ? stops.front() : stops[next];
+		float start = next == 0 ? a.position - 1.0f : a.position;
+		float end = next == stops.size() ? b.position + 1.0f : b.position;
+		float t = end > start ? (position - start) / (end - start) : 0.0f;
+		m_Table[i] = Lerp(a.color, b.color, t);
+	}
+	m_Table[PALETTE_SIZE] = m_Table[PALETTE_SIZE + 1] = Color(0.0f, 0.0f, 0.0f);
+}
+
+bool Palette::Load(const char* path) {
+	FILE* file = fopen(path, "r");
+	if (!file) {
+		std::cerr << "Could not read palette " << path << std::endl;
+		return false;
+	}
+
+	std::vector<PaletteStop> stops;
+	char line[256];
+	while (fgets(line, sizeof(line), file)) {
+		if (line[0] == '#') continue;
+		float position, r, g, b;
+		if (sscanf(line, "%f %f %f %f", &position, &r, &g, &b) != 4) continue;
+		stops.push_back(PaletteStop{ position - std::floor(position), Color(r, g, b) / 255.0f });
+	}
+	fclose(file);
+
+	if (stops.empty()) {
+		std::cerr << "Palette " << path << " contains no stops" << std::endl;
+		return false;
+	}
+	std::stable_sort(stops.begin(), stops.end(), [](const PaletteStop& a, const PaletteStop& b) { return a.position < b.position; });
+	SetStops(stops);
+
+	// Name the palette after the file, without directory and extension.
+	std::string name = path;
+	size_t slash = name.find_last_of("/\\");
+	if (slash != std::string::npos) name = name.substr(slash + 1);
+	m_Name = name.substr(0, name.find_last_of('.'));
+	return true;
+}
+
+void Palette::SetPeriod(int iterations) {
+	// A whole number of table entries per iteration keeps the integer path free of multiplications by fractions.
+	m_Step = std::max(1, std::min(PALETTE_SIZE, PALETTE_SIZE / std::max(iterations, 1)));
+}
+
+Color Palette::GetColor(float smooth) const {
+	if (smooth < 0.0f) return m_Table[PALETTE_SIZE];
+	float index = smooth * (float)m_Step + (float)m_Offset;
+	int whole = (int)index;
+	return Lerp(m_Table[whole & (PALETTE_SIZE - 1)], m_Table[(whole + 1) & (PALETTE_SIZE - 1)], index - (float)whole);
+}
+
+void Palette::ColorizeScalar(const int* iterations, const float* smooth, size_t begin, size_t end, Color* colors) const {
+	if (smooth)
+		for (size_t i = begin; i < end; i++) colors[i] = GetColor(smooth[i]);
+	else
+		for (size_t i = begin; i < end; i++) colors[i] = GetColor(iterations[i]);
+}
+
+#ifdef __AVX2__
+/** Gathers the colors of two of eight table indices, a Color is four floats so one gather fetches both completely.
+* @param[in] table				Color table as floats.
+* @param[in] indices			Eight table indices.
+* @param[in] pair				Which two indices to gather, in [0, 4).
+*/
+static inline __m256 GatherPair(const float* table, __m256i indices, int pair) {
+	const __m256i components = _mm256_setr_epi32(0, 1, 2, 3, 0, 1, 2, 3);
+	__m256i select = _mm256_setr_epi32(2 * pair, 2 * pair, 2 * pair, 2 * pair, 2 * pair + 1, 2 * pair + 1, 2 * pair + 1, 2 * pair + 1);
+	__m256i offsets = _mm256_add_epi32(_mm256_slli_epi32(_mm256_permutevar8x32_epi32(indices, select), 2), components);
+	return _mm256_i32gather_ps(table, offsets, 4);
+}
+#endif
+
+void Palette::ColorizeRange(const int* iterations, const float* smooth, size_t begin, size_t end, Color* colors) const {
+	size_t i = begin;
+#ifdef __AVX2__
+	const float* table = &m_Table[0].r;
+	const __m256i mask = _mm256_set1_epi32(PALETTE_SIZE - 1);
+	const __m256i interior = _mm256_set1_epi32(PALETTE_SIZE);
+
+	if (smooth) {
+		const __m256 step = _mm256_set1_ps((float)m_Step), offset = _mm256_set1_ps((float)m_Offset);
+		for (; i + 8 <= end; i += 8) {
+			__m256 value = _mm256_loadu_ps(smooth + i);
+			__m256i inside = _mm256_castps_si256(_mm256_cmp_ps(value, _mm256_setzero_ps(), _CMP_LT_OQ));
+
+			__m256 index = _mm256_add_ps(_mm256_mul_ps(_mm256_max_ps(value, _mm256_setzero_ps()), step), offset);
+			__m256 whole = _mm256_floor_ps(index);
+			__m256 t = _mm256_sub_ps(index, whole);
+			__m256i first = _mm256_and_si256(_mm256_cvttps_epi32(whole), mask);
+			__m256i second = _mm256_and_si256(_mm256_add_epi32(first, _mm256_set1_epi32(1)), mask);
+			first = _mm256_blendv_epi8(first, interior, inside);
+			second = _mm256_blendv_epi8(second, interior, inside);
+
+			for (int pair = 0; pair < 4; pair++) {
+				__m256 a = GatherPair(table, first, pair), b = GatherPair(table, second, pair);
+				__m256i select = _mm256_setr_epi32(2 * pair, 2 * pair, 2 * pair, 2 * pair, 2 * pair + 1, 2 * pair + 1, 2 * pair + 1, 2 * pair + 1);
+				__m256 weight = _mm256_permutevar8x32_ps(t, select);
+				_mm256_storeu_ps(&colors[i + 2 * pair].r, _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), weight)));
+			}
+		}
+	}
+	else {
+		const __m256i step = _mm256_set1_epi32(m_Step), offset = _mm256_set1_epi32(m_Offset);
+		for (; i + 8 <= end; i += 8) {
+			__m256i iteration = _mm256_loadu_si256((const __m256i*)(iterations + i));
+			__m256i inside = _mm256_cmpgt_epi32(_mm256_setzero_si256(), iteration);
+			__m256i index = _mm256_and_si256(_mm256_add_epi32(_mm256_mullo_epi32(iteration, step), offset), mask);
+			index = _mm256_blendv_epi8(index, interior, inside);
+
+			for (int pair = 0; pair < 4; pair++)
+				_mm256_storeu_ps(&colors[i + 2 * pair].r, GatherPair(table, index, pair));
+		}
+	}
+#endif
+	ColorizeScalar(iterations, smooth, i, end, colors);
+}
+
+void Palette::Colorize(const int* iterations, const float* smooth, size_t pixels, Color* colors) const {
+	// Blocks of pixels per thread, a multiple of 8 so only the last block has a scalar tail.
+	const size_t blockSize = 4096;
+	const int blocks = (int)((pixels + blockSize - 1) / blockSize);
+#pragma omp parallel for
+	for (int block = 0; block < blocks; block++) {
+		size_t begin = (size_t)block * blockSize;
+		ColorizeRange(iterations, smooth, begin, std::min(begin + blockSize, pixels), colors);
+	}
+}
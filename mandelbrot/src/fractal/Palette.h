@@ -0,0 +1,70 @@
+#pragma once
+#include "tmpl/incl.h"
+
+/* Number of entries of a palette lookup table, a power of two so indices wrap with a mask. */
+#define PALETTE_SIZE 1024
+
+/* A color at a position in [0, 1) of a palette, colors in between are interpolated. */
+struct PaletteStop {
+	float position;
+	Color color;
+};
+
+/** Colors iteration counts through a precomputed lookup table. The table repeats every period iterations, so cycling the
+* palette only changes the offset into the table and the iteration counts do not have to be computed again.
+*/
+class Palette {
+
+public:
+	/** Creates the classic palette of the application. */
+	Palette();
+
+	/** Loads a palette from a text file with one "position r g b" stop per line, position in [0, 1) and colors in [0, 255].
+	* Lines starting with # are ignored.
+	* @param[in] path			Path to the palette file.
+	* @returns					false if the file could not be read or contains no stops, the palette is unchanged.
+	*/
+	bool Load(const char* path);
+	/** Replaces the stops and regenerates the lookup table.
+	* @param[in] stops			Stops sorted by position.
+	*/
+	void SetStops(const std::vector<PaletteStop>& stops);
+	/** Restores the classic palette. */
+	void SetClassic();
+
+	/** Sets the number of iterations after which the palette repeats, rounded to a divisor of PALETTE_SIZE. */
+	void SetPeriod(int iterations);
+	int GetPeriod() const { return PALETTE_SIZE / m_Step; }
+	/** Shifts the palette by a number of table entries, used for palette cycling. */
+	void SetOffset(int offset) { m_Offset = offset & (PALETTE_SIZE - 1); }
+	int GetOffset() const { return m_Offset; }
+
+	/** Color of an iteration count, -1 inside the set. */
+	Color GetColor(int iteration) const {
+		return iteration < 0 ? m_Table[PALETTE_SIZE] : m_Table[(iteration * m_Step + m_Offset) & (PALETTE_SIZE - 1)];
+	}
+	/** Color of a continuous iteration count, negative inside the set. */
+	Color GetColor(float smooth) const;
+
+	/** Colors the pixels of a frame.
+	* @param[in] iterations		Iteration count per pixel, -1 inside the set.
+	* @param[in] smooth			Continuous iteration count per pixel, nullptr to color by the integer counts.
+	* @param[in] pixels			Number of pixels.
+	* @param[out] colors		Color per pixel.
+	*/
+	void Colorize(const int* iterations, const float* smooth, size_t pixels, Color* colors) const;
+
+	const std::string& GetName() const { return m_Name; }
+
+private:
+	/** Table of PALETTE_SIZE colors, followed by the interior color twice so interior pixels index it like any other entry. */
+	std::vector<Color> m_Table;
+	/** Table entries per iteration and the current cycling offset. */
+	int m_Step = 8, m_Offset = 0;
+	std::string m_Name;
+
+	/** Colors a range of pixels with scalar code. */
+	void ColorizeScalar(const int* iterations, const float* smooth, size_t begin, size_t end, Color* colors) const;
+	/** Colors a range of pixels, 8 at a time with AVX2 gathers when available. */
+	void ColorizeRange(const int* iterations, const float* smooth, size_t begin, size_t end, Color* colors) const;
+};
@@ -0,0 +1,184 @@
+#include "clMandelbrot.h"
+#include <cstring>
+
+clMandelbrot::clMandelbrot(uint width, uint height, const char* kernelPath)
+	: m_Width(width), m_Height(height) {
+	m_Context = new clContext(false);
+	m_Context->PrintDeviceInfo();
+	m_Queue = new clCommandQueue(m_Context, false, true);
+
+	m_Programs = new clProgramCache(m_Context, kernelPath, "variants.db");
+	m_Variant = GetVariantDefines();
+	m_VariantSettings = m_Settings;
+	m_Program = m_Programs->Get(m_Variant);
+	if (!m_Program) FATAL_ERROR("Failed to build the OpenCL program.");
+	m_Programs->RecordUsage(m_Variant);
+	m_Kernel = new clKernel(m_Program, "mandelbrot");
+	m_PersistentKernel = new clKernel(m_Program, "mandelbrot_persistent");
+	m_WorkCounter = new clBuffer(m_Context, sizeof(int), BufferFlags::READ_WRITE);
+	m_Tuner = new clWorkGroupTuner(m_Context, "worksizes.db");
+
+	// int and float have the same size, both buffers are allocated alike.
+	size_t size = sizeof(int) * width * height;
+	m_Iterations = new clBuffer(m_Context, size, BufferFlags::WRITE_ONLY);
+	m_Smooth = new clBuffer(m_Context, size, BufferFlags::WRITE_ONLY);
+	// CPU and integrated devices can use our memory directly, discrete GPUs prefer pinned memory allocated by the driver.
+	HostMemory hostMemory = m_Context->HasHostUnifiedMemory() ? HostMemory::USE_HOST_PTR : HostMemory::ALLOC_HOST_PTR;
+	m_IterationsHost = new clBuffer(m_Context, size, BufferFlags::WRITE_ONLY, hostMemory);
+	m_SmoothHost = new clBuffer(m_Context, size, BufferFlags::WRITE_ONLY, hostMemory);
+	m_HostIterations = new int[width * height];
+	m_HostSmooth = new float[width * height];
+}
+
+clMandelbrot::~clMandelbrot() {
+	delete[] m_HostSmooth;
+	delete[] m_HostIterations;
+	delete m_SmoothHost;
+	delete m_IterationsHost;
+	delete m_Smooth;
+	delete m_Iterations;
+	delete m_Tuner;
+	delete m_WorkCounter;
+	delete m_PersistentKernel;
+	delete m_Kernel;
+	delete m_Programs;
+	delete m_Queue;
+	delete m_Context;
+}
+
+std::string clMandelbrot::GetVariantDefines() {
+	char defines[256];
+	snprintf(defines, sizeof(defines), "-D MAX_ITERATIONS=%i -D USE_DOUBLE=%i -D FORMULA=%i -D SMOOTH=%i%s",
+		m_Settings.maxIterations, m_Settings.doublePrecision ? 1 : 0, m_Settings.formula, m_Settings.smooth ? 1 : 0,
+		m_Settings.doublePrecision ? "" : " -cl-single-precision-constant");
+	return std::string(defines);
+}
+
+void clMandelbrot::UpdateVariant() {
+	std::string defines = GetVariantDefines();
+	if (defines == m_Variant) return;
+
+	clProgram* program = m_Programs->TryGet(defines);
+	if (!program) {
+		if (m_Programs->HasFailed(defines)) {
+			// The build log was reported by the cache, drop the request and keep the last good variant.
+			if (defines != m_FailedVariant) std::cerr << "Keeping program variant " << m_Variant << std::endl;
+			m_FailedVariant = defines;
+			m_Settings.maxIterations = m_VariantSettings.maxIterations;
+			m_Settings.doublePrecision = m_VariantSettings.doublePrecision;
+			m_Settings.formula = m_VariantSettings.formula;
+			m_Settings.smooth = m_VariantSettings.smooth;
+		}
+		return;
+	}
+
+	delete m_Kernel;
+	delete m_PersistentKernel;
+	m_Program = program;
+	m_Variant = defines;
+	m_Programs->RecordUsage(m_Variant);
+	m_FailedVariant.clear();
+	m_VariantSettings = m_Settings;
+	m_Kernel = new clKernel(m_Program, "mandelbrot");
+	m_PersistentKernel = new clKernel(m_Program, "mandelbrot_persistent");
+	m_LocalSize[0] = m_LocalSize[1] = 0;
+}
+
+bool clMandelbrot::WaitForVariant() {
+	bool built = m_Programs->Get(GetVariantDefines()) != nullptr;
+	UpdateVariant();
+	return built;
+}
+
+void clMandelbrot::EnqueueKernel(const View& view, clBuffer* buffer, clBuffer* smooth) {
+	bool doublePrecision = m_VariantSettings.doublePrecision;
+
+	cl_float2 center = { (float)view.centerX, (float)view.centerY };
+	float zoom = (float)view.zoom;
+	cl_double2 centerDouble = { view.centerX, view.centerY };
+	double zoomDouble = view.zoom;
+	// Center and zoom are passed in the precision of the variant.
+	void* centerArg = doublePrecision ? (void*)&centerDouble : (void*)&center;
+	void* zoomArg = doublePrecision ? (void*)&zoomDouble : (void*)&zoom;
+	size_t centerSize = doublePrecision ? sizeof(cl_double2) : sizeof(cl_float2);
+	size_t zoomSize = doublePrecision ? sizeof(double) : sizeof(float);
+
+	if (m_Settings.kernelMode == KernelMode::NDRange) {
+		m_Kernel->SetArgument(0, buffer);
+		m_Kernel->SetArgument(1, smooth);
+		m_Kernel->SetArgument(2, &m_Width, sizeof(uint));
+		m_Kernel->SetArgument(3, &m_Height, sizeof(uint));
+		m_Kernel->SetArgument(4, centerArg, centerSize);
+		m_Kernel->SetArgument(5, zoomArg, zoomSize);
+
+		size_t globalSize[2] = { m_Width, m_Height };
+		if (!m_LocalSize[0]) m_Tuner->GetLocalSize(m_Queue, m_Kernel, m_Variant, globalSize, m_LocalSize);
+		m_Kernel->Enqueue(m_Queue, 2, globalSize, m_LocalSize, m_Profiler.Record("mandelbrot"));
+	}
+	else {
+		int zero = 0;
+		m_WorkCounter->Fill(m_Queue, &zero, sizeof(int), m_Profiler.Record("reset counter"));
+
+		m_PersistentKernel->SetArgument(0, buffer);
+		m_PersistentKernel->SetArgument(1, smooth);
+		m_PersistentKernel->SetArgument(2, m_WorkCounter);
+		m_PersistentKernel->SetArgument(3, &m_Width, sizeof(uint));
+		m_PersistentKernel->SetArgument(4, &m_Height, sizeof(uint));
+		m_PersistentKernel->SetArgument(5, centerArg, centerSize);
+		m_PersistentKernel->SetArgument(6, zoomArg, zoomSize);
+		m_PersistentKernel->SetArgument(7, &m_Settings.batchSize, sizeof(int));
+
+		// Just enough groups to keep every compute unit busy, they loop until the counter runs out.
+		size_t localSize = m_PersistentKernel->GetPreferredWorkGroupSizeMultiple(m_Context);
+		if (localSize < 64) localSize = 64;
+		if (localSize > m_PersistentKernel->GetMaxWorkGroupSize(m_Context)) localSize = m_PersistentKernel->GetMaxWorkGroupSize(m_Context);
+		size_t globalSize = m_Context->GetComputeUnits() * 4 * localSize;
+		m_PersistentKernel->Enqueue(m_Queue, globalSize, localSize, m_Profiler.Record("mandelbrot_persistent"));
+	}
+}
+
+void clMandelbrot::Render(const View& view, const std::function<void(const int*, const float*)>& consume) {
+	UpdateVariant();
+	m_Profiler.BeginFrame();
+	bool smooth = m_VariantSettings.smooth;
+
+	if (m_Settings.readback == Readback::Copy) {
+		EnqueueKernel(view, m_Iterations, m_Smooth);
+		if (smooth) m_Smooth->CopyToHost(m_Queue, m_HostSmooth, false, m_Profiler.Record("read"));
+		m_Iterations->CopyToHost(m_Queue, m_HostIterations, true, m_Profiler.Record("read"));
+		consume(m_HostIterations, smooth ? m_HostSmooth : nullptr);
+	}
+	else {
+		// Consume the results in place.
+		EnqueueKernel(view, m_IterationsHost, m_SmoothHost);
+		clMappedBuffer mapped(m_Queue, m_IterationsHost, MapFlags::READ, m_Profiler.Record("map"));
+		if (smooth) {
+			clMappedBuffer mappedSmooth(m_Queue, m_SmoothHost, MapFlags::READ, m_Profiler.Record("map"));
+			consume(mapped.As<int>(), mappedSmooth.As<float>());
+			mappedSmooth.Unmap(m_Profiler.Record("unmap"));
+		}
+		else consume(mapped.As<int>(), nullptr);
+		mapped.Unmap(m_Profiler.Record("unmap"));
+	}
+
+	m_Profiler.EndFrame();
+	m_KernelTime = m_Profiler.GetExecutionTime(m_Settings.kernelMode == KernelMode::NDRange ? "mandelbrot" : "mandelbrot_persistent");
+	m_ReadbackTime = m_Profiler.GetExecutionTime("read") + m_Profiler.GetExecutionTime("map") + m_Profiler.GetExecutionTime("unmap");
+}
+
+void clMandelbrot::Render(const View& view, int* iterations) {
+	size_t size = sizeof(int) * m_Width * m_Height;
+	Render(view, [iterations, size](const int* result, const float*) { memcpy(iterations, result, size); });
+}
+
+void clMandelbrot::TuneWorkSize() {
+	// Tuning runs the kernel with its current arguments, render once so they are set.
+	KernelMode mode = m_Settings.kernelMode;
+	m_Settings.kernelMode = KernelMode::NDRange;
+	Render(View{ -0.75, 0.1, 1.0 }, [](const int*, const float*) {});
+	m_Settings.kernelMode = mode;
+
+	size_t globalSize[2] = { m_Width, m_Height };
+	m_Tuner->Tune(m_Queue, m_Kernel, m_Variant, globalSize, m_LocalSize);
+	m_Tuner->Save();
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include "Mandelbrot.h"
+#include "tmpl/ocl.h"
+#include "tmpl/oclTuner.h"
+#include "tmpl/oclProfiler.h"
+#include "tmpl/oclProgramCache.h"
+#include <functional>
+
+/* OpenCL kernel used for computing the Mandelbrot set. */
+enum class KernelMode : int {
+	/* One work-item per pixel. */
+	NDRange = 0,
+	/* A fixed number of work-groups pulling pixel batches from an atomic counter. */
+	Persistent = 1
+};
+
+/* How the OpenCL results are transferred back to the host. */
+enum class Readback : int {
+	/* clEnqueueReadBuffer into a host array. */
+	Copy = 0,
+	/* Map a host-visible buffer and consume the results in place. */
+	Map = 1
+};
+
+/* Settings of the OpenCL renderer, may be changed between frames. */
+struct clMandelbrotSettings {
+	KernelMode kernelMode = KernelMode::NDRange;
+	Readback readback = Readback::Map;
+	/* Pixels claimed per work-item at once by the persistent kernel. */
+	int batchSize = 4;
+	/* Compile-time parameters of the program variant. */
+	int maxIterations = 256;
+	bool doublePrecision = false;
+	int formula = 0;
+	/* Compute continuous iteration counts. */
+	bool smooth = false;
+};
+
+/** Computes the iterations of the Mandelbrot set with OpenCL. */
+class clMandelbrot {
+
+public:
+	/** Creates the OpenCL context, builds the program and allocates the iteration buffers.
+	* @param[in] width			Image width.
+	* @param[in] height			Image height.
+	* @param[in] kernelPath		Path to the OpenCL source code.
+	*/
+	clMandelbrot(uint width, uint height, const char* kernelPath = "assets/kernels/mandelbrot.cl");
+	~clMandelbrot();
+
+	/** Computes the iterations for a view.
+	* @param[in] view			Region of the complex plane.
+	* @param[in] consume		Called with the iteration counts (-1 inside the set) and the continuous counts, nullptr if the
+	*							variant does not compute them. Only valid during the call.
+	*/
+	void Render(const View& view, const std::function<void(const int*, const float*)>& consume);
+	/** Computes the iterations for a view and copies them to the host.
+	* @param[in] view			Region of the complex plane.
+	* @param[out] iterations	Iteration count per pixel, -1 inside the set. Of size width * height.
+	*/
+	void Render(const View& view, int* iterations);
+
+	/** Blocks until the variant selected in the settings is built and switches to it.
+	* @returns					False if the build failed, the settings are reverted to the variant in use.
+	*/
+	bool WaitForVariant();
+	/** Times all work sizes of the NDRange kernel again and stores the fastest. */
+	void TuneWorkSize();
+
+	clMandelbrotSettings& GetSettings() { return m_Settings; }
+	/** Retrieves the settings the variant in use was built with, may lag behind the settings while a variant is being built. */
+	const clMandelbrotSettings& GetVariantSettings() { return m_VariantSettings; }
+	/** Checks whether the variant selected in the settings is still being built. */
+	bool IsVariantPending() { return GetVariantDefines() != m_Variant; }
+	/** Retrieves the build defines of the last variant that failed to build, empty if none failed since the last switch. */
+	const std::string& GetFailedVariant() { return m_FailedVariant; }
+	/** Retrieves the local work size of the NDRange kernel, zero until tuned. */
+	const size_t* GetLocalSize() { return m_LocalSize; }
+	/** Retrieves the kernel and readback time of the last frame (in ms). */
+	double GetKernelTime() { return m_KernelTime; }
+	double GetReadbackTime() { return m_ReadbackTime; }
+
+	clContext* GetContext() { return m_Context; }
+	clCommandQueue* GetQueue() { return m_Queue; }
+	clProfiler& GetProfiler() { return m_Profiler; }
+
+private:
+	uint m_Width, m_Height;
+	clMandelbrotSettings m_Settings;
+
+	clContext* m_Context = nullptr;
+	clCommandQueue* m_Queue = nullptr;
+	/* Built specializations of the program and the variant in use. */
+	clProgramCache* m_Programs = nullptr;
+	clProgram* m_Program = nullptr;
+	std::string m_Variant, m_FailedVariant;
+	clMandelbrotSettings m_VariantSettings;
+	clKernel* m_Kernel = nullptr;
+	clKernel* m_PersistentKernel = nullptr;
+	/* Atomic work counter of the persistent kernel. */
+	clBuffer* m_WorkCounter = nullptr;
+	/* Picks the local work size of the kernel, tuned per device. */
+	clWorkGroupTuner* m_Tuner = nullptr;
+	size_t m_LocalSize[2] = { 0, 0 };
+	/* Device-only iteration buffers, read back with a copy. */
+	clBuffer* m_Iterations = nullptr;
+	clBuffer* m_Smooth = nullptr;
+	/* Host-visible iteration buffers, read back by mapping. */
+	clBuffer* m_IterationsHost = nullptr;
+	clBuffer* m_SmoothHost = nullptr;
+	/* Host destination for copied iteration counts. */
+	int* m_HostIterations = nullptr;
+	float* m_HostSmooth = nullptr;
+	/* Collects the profiling events of every command per frame. */
+	clProfiler m_Profiler;
+
+	double m_KernelTime = 0.0, m_ReadbackTime = 0.0;
+
+	/** Build defines for the variant selected in the settings. */
+	std::string GetVariantDefines();
+	/** Switches to the selected program variant once it has been built, keeps using the current variant meanwhile. If the
+	* build failed, the build parameters of the settings are reverted to the variant in use.
+	*/
+	void UpdateVariant();
+	/** Sets the kernel arguments and enqueues the kernel of the selected mode.
+	* @param[in] view			Region of the complex plane.
+	* @param[in] buffer			Buffer the iterations are written to.
+	* @param[in] smooth			Buffer the continuous iteration counts are written to.
+	*/
+	void EnqueueKernel(const View& view, clBuffer* buffer, clBuffer* smooth);
+};
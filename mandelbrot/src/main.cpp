@@ -1,4 +1,23 @@
 #include "tmpl/App.h"
+#include "tmpl/FrameTimer.h"
+#include "tmpl/PerfCounters.h"
+#include "tmpl/Trace.h"
+#include "fractal/Mandelbrot.h"
+#include "fractal/AdaptiveIterations.h"
+#include "fractal/Buddhabrot.h"
+#include "fractal/DistanceEstimation.h"
+#include "fractal/Formula.h"
+#include "fractal/FormulaJit.h"
+#include "fractal/Antialiasing.h"
+#include "fractal/HistogramColoring.h"
+#include "fractal/InteriorDistance.h"
+#include "fractal/IterationStats.h"
+#include "fractal/JuliaGrid.h"
+#include "fractal/Lyapunov.h"
+#include "fractal/Mandelbulb.h"
+#include "fractal/Newton.h"
+#include "fractal/Palette.h"
+#include "fractal/clMandelbrot.h"
 #include <chrono>
 #include <imgui_impl_opengl3.h>
 #include <imgui_impl_glfw.h>
@@ -7,17 +26,50 @@
 #define HEIGHT 720
 #define MAX_ITERATIONS 1 << 8
 
-#define NUM_THREADS 12	// Adjust to your own machine. Number of virtual cores is usually a good value.
+/* Fractal computed by the CPU backend. */
+enum class FractalMode : int {
+	EscapeTime = 0,
+	Newton = 1,
+	Lyapunov = 2,
+	Custom = 3
+};
+
+/* Kernel of the CPU backend. */
+enum class CpuKernel : int {
+	Escape = 0,
+	DistanceEstimate = 1
+};
+
+/* Device used for computing the Mandelbrot set. */
+enum class Backend : int {
+	CPU = 0,
+	OpenCL = 1
+};
 
 class DemoApp : public App {
 
 public:
 	DemoApp(uint width, uint height) : App(width, height) {
-		// Reserve memory for our color array.
+		// Reserve memory for our color and iteration arrays.
 		m_Colors = new Color[width * height];
+		m_Iterations = new int[width * height];
+		m_SmoothIterations = new float[width * height];
+		m_Equalized = new float[width * height];
+		m_Distances = new float[width * height];
+		m_Roots = new int[width * height];
+		m_Exponents = new float[width * height];
 	}
 	~DemoApp() {
 		delete[] m_Colors;
+		delete[] m_Iterations;
+		delete[] m_SmoothIterations;
+		delete[] m_Equalized;
+		delete[] m_Distances;
+		delete[] m_Roots;
+		delete[] m_Exponents;
+		delete m_clMandelbrot;
+		delete m_Buddhabrot;
+		delete m_PerfCounters;
 	}
 
 protected:
@@ -31,6 +83,94 @@ protected:
 	*/
 	Color* m_Colors = nullptr;
 	/*
+	* Iteration count per pixel computed by the CPU backend.
+	*/
+	int* m_Iterations = nullptr;
+	/*
+	* Continuous iteration count per pixel computed by the CPU backend when smooth coloring is enabled.
+	*/
+	float* m_SmoothIterations = nullptr;
+	bool m_Smooth = false;
+	/*
+	* Fractal of the CPU backend.
+	*/
+	FractalMode m_Mode = FractalMode::EscapeTime;
+	/*
+	* Polynomial of the Newton fractal, its source text and the root each pixel converged to.
+	*/
+	NewtonPolynomial m_Newton;
+	char m_NewtonText[128] = "z^3 - 1";
+	int* m_Roots = nullptr;
+	/*
+	* Sequence and steps of the Lyapunov fractal, the sequence being edited and the exponent per pixel.
+	*/
+	LyapunovSettings m_Lyapunov;
+	char m_LyapunovText[LYAPUNOV_MAX_SEQUENCE + 1] = "AB";
+	float* m_Exponents = nullptr;
+	/*
+	* Compiler of custom escape-time formulas and the formula being edited.
+	*/
+	FormulaJit m_Jit;
+	char m_JitText[256] = "z^2 + c";
+	/*
+	* Kernel of the CPU backend and the distance estimates per pixel it computes in distance estimation mode.
+	*/
+	CpuKernel m_CpuKernel = CpuKernel::Escape;
+	/*
+	* Formula of the CPU backend. Distance estimation, interior skipping and anti-aliasing only apply to the Mandelbrot set.
+	*/
+	FormulaParams m_Formula;
+	float* m_Distances = nullptr;
+	float m_OutlineThickness = 2.0f;
+	/*
+	* Whether the escape time kernel marks blocks inside the interior distance of their center without iterating them.
+	*/
+	bool m_SkipInterior = false;
+	InteriorSkipStats m_InteriorStats;
+	/*
+	* Progressive Buddhabrot renderer, created when first enabled. The view stays fixed while it accumulates.
+	*/
+	Buddhabrot* m_Buddhabrot = nullptr;
+	BuddhabrotSettings m_BuddhabrotSettings;
+	bool m_ShowBuddhabrot = false;
+	float m_BuddhabrotGamma = 0.5f;
+	/*
+	* Grid of Julia set thumbnails for the c values around the cursor, drawn over the frame.
+	*/
+	JuliaGrid m_JuliaGrid;
+	bool m_ShowJuliaGrid = false;
+	/*
+	* Ray-marched Mandelbulb, rendered instead of the Mandelbrot set from a camera orbiting it.
+	*/
+	Camera m_Camera;
+	MandelbulbSettings m_MandelbulbSettings;
+	MandelbulbStats m_MandelbulbStats;
+	bool m_ShowMandelbulb = false;
+	/*
+	* Palette the iteration counts are colored with and its cycling speed (in table entries per second).
+	*/
+	Palette m_Palette;
+	int m_PaletteIndex = 0;
+	char m_PalettePath[256] = "assets/palettes/fire.pal";
+	float m_CycleSpeed = 0.0f, m_CycleOffset = 0.0f;
+	/*
+	* Histogram-equalized coloring and the equalized value per pixel it colors with.
+	*/
+	HistogramColoring m_HistogramColoring;
+	bool m_Equalize = false;
+	float* m_Equalized = nullptr;
+	/*
+	* Whether the view is frozen, frozen frames are only recolored from the stored iteration counts.
+	*/
+	bool m_Freeze = false, m_Frozen = false, m_FrozenSmooth = false;
+	/*
+	* Adaptive anti-aliasing of edge pixels and its statistics of the last frame.
+	*/
+	AntialiasSettings m_Antialias;
+	AntialiasStats m_AntialiasStats;
+	int m_FrozenMaxIterations = 0;
+	FractalMode m_FrozenMode = FractalMode::EscapeTime;
+	/*
 	* Average time to compute a frame (in seconds).
 	*/
 	float m_AvgFrameTime = 1.0f;
@@ -39,19 +179,190 @@ protected:
 	*/
 	float m_LastFrame = 0.0f;
 
+	/*
+	* Backend used for computing the Mandelbrot set.
+	*/
+	Backend m_Backend = Backend::CPU;
+	/*
+	* OpenCL renderer, created when the OpenCL backend is first selected.
+	*/
+	clMandelbrot* m_clMandelbrot = nullptr;
+	/*
+	* Average kernel time per kernel mode (in ms).
+	*/
+	double m_AvgKernelTime[2] = { 0.0, 0.0 };
+	/*
+	* Value of the OpenCL iterations slider while it is dragged, 0 otherwise.
+	*/
+	int m_EditedIterations = 0;
+	/*
+	* Average host time per frame of the readback benchmark (in ms), for copying and mapping respectively.
+	*/
+	double m_BenchCopyTime = 0.0, m_BenchMapTime = 0.0;
+	/*
+	* Hardware counters around the CPU compute phase, created when enabled in the debug window.
+	*/
+	PerfCounters* m_PerfCounters = nullptr;
+	bool m_CountersEnabled = false;
+	/*
+	* Counter values of the last frame.
+	*/
+	PerfSample m_LastCounters;
+	/*
+	* Iteration statistics of the last frame and whether they and the cost heatmap are computed.
+	*/
+	IterationStats m_Stats;
+	bool m_RecordStats = false, m_ShowHeatmap = false;
+	float m_HeatmapOpacity = 0.75f;
+	/*
+	* Iteration cap of the CPU backend, adjusted every frame when the adaptive cap is enabled.
+	*/
+	int m_MaxIterations = MAX_ITERATIONS;
+	AdaptiveIterations m_AdaptiveIterations;
+
+
+	/*
+	* Colors the color-buffer according to the iteration counts.
+	* @param[in] iterations			Iteration count per pixel, -1 for pixels inside the set.
+	* @param[in] smooth				Continuous iteration count per pixel, nullptr to color by the integer counts.
+	* @param[in] maxIterations		Maximum number of iterations the frame was computed with.
+	*/
+	void Colorize(const int* iterations, const float* smooth, int maxIterations) {
+		ScopedTimer timer(FramePhase::Colorize);
+		if (m_Equalize) {
+			// One palette period spans the whole distribution, the last table entry is not reached so the top does not wrap.
+			m_HistogramColoring.Update(iterations, WIDTH * HEIGHT, maxIterations);
+			m_HistogramColoring.Remap(iterations, smooth, WIDTH * HEIGHT, m_Palette.GetPeriod() * (1.0f - 1.0f / PALETTE_SIZE), m_Equalized);
+			smooth = m_Equalized;
+		}
+		m_Palette.Colorize(iterations, smooth, WIDTH * HEIGHT, m_Colors);
+	}
+
+	/*
+	* Supersamples the edge pixels of the color-buffer, the samples are colored like the frame.
+	* @param[in] iterations			Iteration count per pixel, -1 for pixels inside the set.
+	* @param[in] smooth				Whether the frame is colored by continuous iteration counts.
+	* @param[in] maxIterations		Maximum number of iterations the frame was computed with.
+	* @param[in] distance			Distance estimates per pixel, nullptr if not computed.
+	*/
+	void Antialias(const int* iterations, bool smooth, int maxIterations, const float* distance) {
+		const float scale = m_Palette.GetPeriod() * (1.0f - 1.0f / PALETTE_SIZE);
+		AntialiasEdges(GetView(), WIDTH, HEIGHT, maxIterations, smooth, iterations, m_Antialias, [&](int iteration, float value) {
+			if (m_Equalize) return m_Palette.GetColor(m_HistogramColoring.Map(smooth ? value : (float)iteration, scale));
+			return smooth ? m_Palette.GetColor(value) : m_Palette.GetColor(iteration);
+		}, m_Colors, m_AntialiasStats, distance);
+	}
+
+	/*
+	* Colors a computed frame and records its statistics when enabled. Newton frames are shaded from m_Roots, Lyapunov
+	* frames from m_Exponents and have no iteration counts.
+	* @param[in] iterations			Iteration count per pixel, -1 for pixels inside the set.
+	* @param[in] smooth				Continuous iteration count per pixel, nullptr if not computed.
+	* @param[in] maxIterations		Maximum number of iterations the frame was computed with.
+	*/
+	void ProcessFrame(const int* iterations, const float* smooth, int maxIterations) {
+		// Newton and Lyapunov frames are only computed on the CPU.
+		FractalMode mode = m_Frozen ? m_FrozenMode : m_Backend == Backend::CPU ? m_Mode : FractalMode::EscapeTime;
+		if (m_Freeze && !m_Frozen) {
+			// Keep the frame so it can be recolored, the OpenCL results are only valid during this call.
+			if (iterations != m_Iterations) memcpy(m_Iterations, iterations, WIDTH * HEIGHT * sizeof(int));
+			if (smooth && smooth != m_SmoothIterations) memcpy(m_SmoothIterations, smooth, WIDTH * HEIGHT * sizeof(float));
+			m_Frozen = true, m_FrozenSmooth = smooth != nullptr, m_FrozenMaxIterations = maxIterations, m_FrozenMode = mode;
+		}
+
+		if (mode == FractalMode::Lyapunov) {
+			ScopedTimer timer(FramePhase::Colorize);
+			ShadeLyapunov(m_Exponents, WIDTH * HEIGHT, m_Colors);
+			return;
+		}
+		if (mode == FractalMode::Newton) {
+			ScopedTimer timer(FramePhase::Colorize);
+			ShadeNewton(iterations, m_Roots, WIDTH * HEIGHT, m_Newton.GetDegree(), maxIterations, m_Colors);
+		}
+		else Colorize(iterations, smooth, maxIterations);
+		// The samples are iterated with the Mandelbrot formula in double precision.
+		bool formulaMatches = mode == FractalMode::EscapeTime && (m_Backend == Backend::CPU ? IsMandelbrot() : m_clMandelbrot->GetVariantSettings().formula == 0);
+		const float* distance = mode == FractalMode::EscapeTime && m_Backend == Backend::CPU && IsMandelbrot() && m_CpuKernel == CpuKernel::DistanceEstimate ? m_Distances : nullptr;
+		if (m_Antialias.enabled && formulaMatches) Antialias(iterations, smooth != nullptr, maxIterations, distance);
+		if (distance) ShadeDistance(distance, WIDTH * HEIGHT, m_OutlineThickness, m_Colors);
+		if (m_RecordStats || m_AdaptiveIterations.GetSettings().enabled) ComputeIterationStats(iterations, WIDTH, HEIGHT, maxIterations, m_Stats);
+		if (m_ShowHeatmap) DrawCostHeatmap(iterations, WIDTH * HEIGHT, maxIterations, m_HeatmapOpacity, m_Colors);
+		if (m_ShowJuliaGrid) DrawJuliaGrid();
+	}
+
+	/*
+	* Renders the Julia set thumbnails for the c values around the cursor and draws them over the color-buffer. The last
+	* thumbnails stay while the cursor is outside the view or over the GUI.
+	*/
+	void DrawJuliaGrid() {
+		int windowWidth, windowHeight;
+		glfwGetWindowSize(m_Window, &windowWidth, &windowHeight);
+		glm::ivec2 cursor = m_InputHelper->GetCursorPosition();
+		// Julia sets are parametrized by the points of the Mandelbrot set, not by the points of a Julia set.
+		bool hovering = cursor.x >= 0 && cursor.y >= 0 && cursor.x < windowWidth && cursor.y < windowHeight && !ImGui::GetIO().WantCaptureMouse;
+		if (hovering && !(m_Backend == Backend::CPU && m_Formula.julia)) {
+			// The window may be resized, the cursor is measured from its top and the rows of the frame from the bottom.
+			double x = (cursor.x + 0.5) * WIDTH / windowWidth, y = HEIGHT - (cursor.y + 0.5) * HEIGHT / windowHeight;
+			View view = GetView();
+			double cx = view.centerX + (x / WIDTH - 0.5) * 2.0 * view.zoom, cy = view.centerY + (y / HEIGHT - 0.5) * 2.0 * view.zoom;
+			FormulaType type = m_Backend == Backend::CPU ? m_Formula.type : FormulaType::Mandelbrot;
+			m_JuliaGrid.Render(type, cx, cy, 2.0 * view.zoom / WIDTH);
+		}
+		m_JuliaGrid.Draw(m_Palette, m_Colors, WIDTH, HEIGHT);
+	}
+
+	/*
+	* Whether the CPU backend computes the Mandelbrot set itself rather than another fractal, formula or a Julia set.
+	*/
+	bool IsMandelbrot() const {
+		return m_Mode == FractalMode::EscapeTime && m_Formula.type == FormulaType::Mandelbrot && !m_Formula.julia;
+	}
+
+	/*
+	* Region of the complex plane for the current zoom-level, centered on the 'seahorse' valley. The Lyapunov fractal
+	* lives in the (a, b) plane of rates between 2 and 4 instead.
+	*/
+	View GetView() {
+		if (m_Mode == FractalMode::Lyapunov) return View{ 3.4, 3.4, 0.6 * m_Zoom };
+		return View{ -0.75, 0.1, (double)m_Zoom };
+	}
+
+	/*
+	* Compute the Mandelbrot set with OpenCL and colorize the results on the host.
+	*/
+	void TickOpenCL() {
+		m_clMandelbrot->GetSettings().smooth = m_Smooth;
+		m_clMandelbrot->Render(GetView(), [this](const int* iterations, const float* smooth) {
+			ProcessFrame(iterations, smooth, m_clMandelbrot->GetVariantSettings().maxIterations);
+		});
+
+		KernelMode mode = m_clMandelbrot->GetSettings().kernelMode;
+		double& avgKernelTime = m_AvgKernelTime[(int)mode];
+		avgKernelTime = avgKernelTime == 0.0 ? m_clMandelbrot->GetKernelTime() : avgKernelTime * 0.95 + m_clMandelbrot->GetKernelTime() * 0.05;
+	}
 
 	/*
-	* Computes the color for the number of iterations it took to compute the Mandelbrot value.
-	* @param[in] iteration			Number of iterations it took to calculate the Mandelbrot value.
-	* @returns						Color corresponding to the value.
+	* Measures the average host time of a frame when reading back by copying versus mapping.
+	* @param[in] frames				Number of frames to compute per method.
 	*/
-	inline Color GetColor(int iteration) {
-		if (iteration < 0) return Color(0.0f);
-		else if (iteration == 0) return Color(1.0f, 0.0f, 0.0f);
-		else if (iteration < 16) return Color(16.0f, 0.0f, 16.0f * iteration - 1.0f) / 255.0f;
-		else if (iteration < 32) return Color(0.0f, 16.0f * (iteration - 16.0f), 16.0f * (32.0f - iteration) - 1.0f) / 255.0f;
-		else if (iteration < 64) return Color(8.0f * (iteration - 32.0f), 8.0f * (64.0f - iteration) - 1.0f, 0.0f) / 255.0f;
-		else return Color(255.0f - (iteration - 64.0f) * 4.0f, 0.0f, 0.0f) / 255.0f;
+	void BenchmarkReadback(int frames) {
+		Readback methods[2] = { Readback::Copy, Readback::Map };
+		double* results[2] = { &m_BenchCopyTime, &m_BenchMapTime };
+		Readback current = m_clMandelbrot->GetSettings().readback;
+
+		for (int m = 0; m < 2; m++) {
+			m_clMandelbrot->GetSettings().readback = methods[m];
+			// Warm-up, the first map of a buffer may allocate.
+			TickOpenCL();
+
+			auto sTime = std::chrono::steady_clock::now();
+			for (int i = 0; i < frames; i++) TickOpenCL();
+			auto eTime = std::chrono::steady_clock::now();
+
+			*results[m] = std::chrono::duration<double, std::milli>(eTime - sTime).count() / frames;
+		}
+
+		m_clMandelbrot->GetSettings().readback = current;
 	}
 
 	/*
@@ -59,41 +370,73 @@ protected:
 	*/
 	void Tick(float dt) override {
 
-		if (m_Zoom < 0.01f) m_ZoomModifier = 0.1f;
-		if (m_Zoom > 1.0f) m_ZoomModifier = -0.1f;
-		m_Zoom += m_ZoomModifier * dt;
+		m_CycleOffset = fmodf(m_CycleOffset + m_CycleSpeed * dt, (float)PALETTE_SIZE);
+		m_Palette.SetOffset((int)floorf(m_CycleOffset));
 
-		auto sTime = std::chrono::system_clock::now();
+		if (m_ShowMandelbulb) {
+			if (!ImGui::GetIO().WantCaptureMouse) m_Camera.Update(*m_InputHelper, dt);
+			auto sTime = std::chrono::steady_clock::now();
+			RenderMandelbulb(m_Camera, WIDTH, HEIGHT, m_MandelbulbSettings, m_Colors, &m_MandelbulbStats);
+			m_LastFrame = std::chrono::duration<float>(std::chrono::steady_clock::now() - sTime).count();
+			m_AvgFrameTime = m_AvgFrameTime * 0.95f + m_LastFrame * 0.05f;
+			return;
+		}
 
-#pragma omp parallel for schedule(dynamic, NUM_THREADS)
-		for (int x = 0; x < WIDTH; x++)
-			for (int y = 0; y < HEIGHT; y++) {
-				// Scale initial values for the 'seahorse' valley
-				double x0 = -0.75 + ((double)x / (double)WIDTH - 0.5) * 2.0 * (double)m_Zoom; // [-2.5, 1.0]
-				double y0 = 0.1 + ((double)y / (double)HEIGHT - 0.5) * 2.0 * (double)m_Zoom; // [-0.9, 1.1]
+		if (m_ShowBuddhabrot) {
+			auto sTime = std::chrono::steady_clock::now();
+			m_Buddhabrot->Step();
+			m_LastFrame = std::chrono::duration<float>(std::chrono::steady_clock::now() - sTime).count();
+			m_AvgFrameTime = m_AvgFrameTime * 0.95f + m_LastFrame * 0.05f;
 
-				double xi = 0.0;
-				double yi = 0.0;
+			ScopedTimer timer(FramePhase::Colorize);
+			m_Buddhabrot->Resolve(m_Colors, m_BuddhabrotGamma);
+			return;
+		}
 
-				double iteration = 0;
-				double xTemp;
+		if (m_Frozen) {
+			// Palette cycling and palette changes only re-index the table, the iterations are not computed again.
+			ProcessFrame(m_Iterations, m_FrozenSmooth ? m_SmoothIterations : nullptr, m_FrozenMaxIterations);
+			return;
+		}
 
-				while (pow(xi, 2) + pow(yi, 2) <= 4.0 && iteration < MAX_ITERATIONS) {
-					xTemp = pow(xi, 2) - pow(yi, 2) + x0;
-					yi = 2 * xi * yi + y0;
-					xi = xTemp;
-					iteration++;
-				}
+		if (m_Zoom < 0.01f) m_ZoomModifier = 0.1f;
+		if (m_Zoom > 1.0f) m_ZoomModifier = -0.1f;
+		m_Zoom += m_ZoomModifier * dt;
 
-				if (iteration >= MAX_ITERATIONS)
-					m_Colors[x + y * m_Width] = GetColor(-1);
-				else
-					m_Colors[x + y * m_Width] = GetColor(iteration);
-			}
+		auto sTime = std::chrono::steady_clock::now();
 
-		auto eTime = std::chrono::system_clock::now();
+		if (m_Backend == Backend::OpenCL) TickOpenCL();
+		else {
+			bool counting = m_CountersEnabled && m_PerfCounters->IsAvailable();
+			if (counting) m_PerfCounters->Start();
+			m_Jit.Update();
+			bool custom = m_Mode == FractalMode::Custom && m_Jit.IsReady();
+			// Compiled formulas, Newton and Lyapunov frames have no continuous iteration count.
+			bool hasSmooth = !custom && m_Mode != FractalMode::Newton && m_Mode != FractalMode::Lyapunov;
+			float* smooth = m_Smooth && hasSmooth ? m_SmoothIterations : nullptr;
+			if (custom)
+				m_Jit.Compute(GetView(), WIDTH, HEIGHT, m_MaxIterations, m_Formula, m_Iterations);
+			else if (m_Mode == FractalMode::Newton)
+				ComputeNewton(GetView(), WIDTH, HEIGHT, m_MaxIterations, m_Newton, m_Iterations, m_Roots);
+			else if (m_Mode == FractalMode::Lyapunov)
+				ComputeLyapunov(GetView(), WIDTH, HEIGHT, m_Lyapunov, m_Exponents);
+			else if (IsMandelbrot() && m_CpuKernel == CpuKernel::DistanceEstimate)
+				ComputeDistances(GetView(), WIDTH, HEIGHT, m_MaxIterations, m_Iterations, m_Distances, smooth);
+			else if (IsMandelbrot() && m_SkipInterior)
+				ComputeIterationsSkipInterior(GetView(), WIDTH, HEIGHT, m_MaxIterations, m_Iterations, smooth, &m_InteriorStats);
+			else ComputeFormula(GetView(), WIDTH, HEIGHT, m_MaxIterations, m_Formula, m_Iterations, smooth);
+			if (counting) m_LastCounters = m_PerfCounters->Stop();
+			ProcessFrame(m_Iterations, smooth, m_MaxIterations);
+		}
+
+		auto eTime = std::chrono::steady_clock::now();
 		m_LastFrame = std::chrono::duration<float>(eTime - sTime).count();
 
+		if (m_AdaptiveIterations.GetSettings().enabled) {
+			m_MaxIterations = m_AdaptiveIterations.Update(m_Stats, m_Zoom);
+			if (m_clMandelbrot) m_clMandelbrot->GetSettings().maxIterations = m_MaxIterations;
+		}
+
 		m_AvgFrameTime = m_AvgFrameTime * 0.95f + m_LastFrame * 0.05f;
 	}
 	void Draw(float dt) override {
@@ -111,6 +454,235 @@ protected:
 		ImGui::SetWindowFontScale(1.5f);
 		ImGui::Text("avg frame: %.1f", m_AvgFrameTime * 1000.0f);
 		ImGui::Text("last frame: %.1f", m_LastFrame * 1000.0f);
+
+		if (ImGui::CollapsingHeader("frame phases")) {
+			FrameTimer& timer = FrameTimer::Get();
+			ImGui::Text("%-10s %7s %7s %7s %7s", "phase", "p50", "p95", "p99", "max");
+			for (int p = 0; p < (int)FramePhase::Count; p++) {
+				const PhaseStats& stats = timer.GetStats((FramePhase)p);
+				ImGui::Text("%-10s %7.2f %7.2f %7.2f %7.2f", FrameTimer::GetName((FramePhase)p), stats.p50, stats.p95, stats.p99, stats.max);
+			}
+
+			if (m_Backend == Backend::CPU && ImGui::Checkbox("hardware counters", &m_CountersEnabled) && m_CountersEnabled && !m_PerfCounters)
+				m_PerfCounters = new PerfCounters();
+			if (m_CountersEnabled && m_Backend == Backend::CPU) {
+				if (!m_PerfCounters->IsAvailable()) ImGui::Text("counters unavailable");
+				else {
+					const size_t pixels = WIDTH * HEIGHT;
+					ImGui::Text("IPC: %.2f", m_LastCounters.GetIPC());
+					ImGui::Text("per pixel: br miss %.3f L1D miss %.3f LLC miss %.4f", m_LastCounters.GetPerPixel(PerfEvent::BranchMisses, pixels),
+						m_LastCounters.GetPerPixel(PerfEvent::L1DMisses, pixels), m_LastCounters.GetPerPixel(PerfEvent::LLCMisses, pixels));
+					if (m_LastCounters.Has(PerfEvent::LicenseStalls) && m_LastCounters.Get(PerfEvent::Cycles) > 0.0)
+						ImGui::Text("licence stalls: %.2f%%", m_LastCounters.Get(PerfEvent::LicenseStalls) / m_LastCounters.Get(PerfEvent::Cycles) * 100.0);
+				}
+			}
+
+			Tracer& tracer = Tracer::Get();
+			if (!tracer.IsCapturing()) {
+				if (ImGui::Button("capture thread trace")) tracer.StartCapture();
+			}
+			else if (ImGui::Button("stop and export thread trace")) {
+				tracer.StopCapture();
+				tracer.ExportChromeTrace("thread_trace.json");
+			}
+		}
+
+		ImGui::Checkbox("smooth coloring", &m_Smooth);
+
+		if (ImGui::CollapsingHeader("palette")) {
+			static const char* palettes[] = { "classic", "fire", "ocean", "grayscale" };
+			if (ImGui::Combo("palette", &m_PaletteIndex, palettes, 4)) {
+				if (m_PaletteIndex == 0) m_Palette.SetClassic();
+				else m_Palette.Load(("assets/palettes/" + std::string(palettes[m_PaletteIndex]) + ".pal").c_str());
+			}
+			ImGui::InputText("file", m_PalettePath, sizeof(m_PalettePath));
+			ImGui::SameLine();
+			if (ImGui::Button("load")) m_Palette.Load(m_PalettePath);
+			ImGui::Text("current: %s", m_Palette.GetName().c_str());
+
+			int period = m_Palette.GetPeriod();
+			if (ImGui::SliderInt("period", &period, 1, PALETTE_SIZE)) m_Palette.SetPeriod(period);
+			ImGui::SliderFloat("cycle speed", &m_CycleSpeed, -PALETTE_SIZE, PALETTE_SIZE);
+			ImGui::Checkbox("histogram coloring", &m_Equalize);
+			if (ImGui::Checkbox("freeze view", &m_Freeze) && !m_Freeze) m_Frozen = false;
+		}
+
+		if (ImGui::CollapsingHeader("buddhabrot")) {
+			if (ImGui::Checkbox("render buddhabrot", &m_ShowBuddhabrot) && m_ShowBuddhabrot) {
+				if (!m_Buddhabrot) m_Buddhabrot = new Buddhabrot(WIDTH, HEIGHT);
+				m_Buddhabrot->Reset(GetView(), m_BuddhabrotSettings);
+			}
+			ImGui::DragInt3("limits rgb", m_BuddhabrotSettings.maxIterations, 10.0f, 1, 100000);
+			ImGui::SliderInt("samples per frame", &m_BuddhabrotSettings.samplesPerStep, 1000, 1000000);
+			ImGui::Checkbox("metropolis-hastings", &m_BuddhabrotSettings.metropolis);
+			if (m_BuddhabrotSettings.metropolis) ImGui::SliderFloat("large mutations", &m_BuddhabrotSettings.largeMutation, 0.0f, 1.0f);
+			if (m_ShowBuddhabrot && ImGui::Button("restart")) m_Buddhabrot->Reset(GetView(), m_BuddhabrotSettings);
+			ImGui::SliderFloat("gamma", &m_BuddhabrotGamma, 0.1f, 2.0f);
+			if (m_ShowBuddhabrot) {
+				const BuddhabrotStats& stats = m_Buddhabrot->GetStats();
+				ImGui::Text("samples: %.1fM contributing: %.2f%%", stats.samples * 1e-6, stats.samples ? 100.0 * stats.contributing / stats.samples : 0.0);
+				if (m_Buddhabrot->GetSettings().metropolis)
+					ImGui::Text("accepted: %.2f%%", stats.samples ? 100.0 * stats.accepted / stats.samples : 0.0);
+			}
+		}
+
+		if (ImGui::CollapsingHeader("mandelbulb")) {
+			ImGui::Checkbox("render mandelbulb", &m_ShowMandelbulb);
+			ImGui::SliderInt("estimator iterations", &m_MandelbulbSettings.iterations, 1, 16);
+			ImGui::SliderInt("max steps", &m_MandelbulbSettings.maxSteps, 16, 512);
+			ImGui::SliderFloat("detail", &m_MandelbulbSettings.detail, 0.25f, 8.0f);
+			if (m_ShowMandelbulb) {
+				ImGui::Text("drag to rotate, W/S to move closer and away");
+				ImGui::Text("hits: %.1f%% steps: %.1f culled tiles: %.1f%%", m_MandelbulbStats.hitFraction * 100.0f,
+					m_MandelbulbStats.averageSteps, m_MandelbulbStats.culledTiles * 100.0f);
+			}
+		}
+
+		if (ImGui::CollapsingHeader("julia preview")) {
+			JuliaGridSettings& grid = m_JuliaGrid.GetSettings();
+			ImGui::Checkbox("show julia grid", &m_ShowJuliaGrid);
+			ImGui::SliderInt("columns", &grid.columns, 1, 12);
+			ImGui::SliderInt("rows", &grid.rows, 1, 8);
+			ImGui::SliderInt("thumbnail size", &grid.size, 16, 128);
+			ImGui::SliderFloat("spacing", &grid.spacing, 1.0f, 64.0f);
+			ImGui::SliderInt("thumbnail iterations", &grid.maxIterations, 16, 1024);
+			if (m_ShowJuliaGrid) ImGui::Text("grid: %.2f ms", m_JuliaGrid.GetRenderTime());
+		}
+
+		if (ImGui::CollapsingHeader("anti-aliasing")) {
+			ImGui::Checkbox("adaptive anti-aliasing", &m_Antialias.enabled);
+			ImGui::SliderInt("samples per axis", &m_Antialias.samplesPerAxis, 2, 8);
+			ImGui::SliderInt("iteration threshold", &m_Antialias.iterationThreshold, 0, 64);
+			ImGui::SliderFloat("color threshold", &m_Antialias.colorThreshold, 0.0f, 1.0f);
+			if (m_CpuKernel == CpuKernel::DistanceEstimate) ImGui::SliderFloat("distance threshold", &m_Antialias.distanceThreshold, 0.0f, 4.0f);
+			if (m_Antialias.enabled)
+				ImGui::Text("resampled: %.2f%% (%.2fM samples)", m_AntialiasStats.resampledFraction * 100.0f, m_AntialiasStats.samples * 1e-6);
+		}
+
+		AdaptiveIterationSettings& adaptive = m_AdaptiveIterations.GetSettings();
+		ImGui::Checkbox("adaptive iterations", &adaptive.enabled);
+		if (adaptive.enabled) {
+			ImGui::DragIntRange2("bounds", &adaptive.minIterations, &adaptive.maxIterations, 16.0f, 16, 1 << 16);
+			ImGui::Text("cap: %i late escapes: %.3f%%", m_AdaptiveIterations.GetCap(), m_Stats.lateEscapeFraction * 100.0f);
+		}
+		else if (m_Backend == Backend::CPU) ImGui::SliderInt("iterations", &m_MaxIterations, 16, 4096);
+
+		if (ImGui::CollapsingHeader("iteration stats")) {
+			ImGui::Checkbox("record stats", &m_RecordStats);
+			ImGui::SameLine();
+			ImGui::Checkbox("cost heatmap", &m_ShowHeatmap);
+			if (m_ShowHeatmap) ImGui::SliderFloat("opacity", &m_HeatmapOpacity, 0.0f, 1.0f);
+			if (m_RecordStats) {
+				float histogram[HISTOGRAM_BINS];
+				for (int b = 0; b < HISTOGRAM_BINS; b++) histogram[b] = (float)m_Stats.histogram[b];
+				ImGui::PlotHistogram("##histogram", histogram, HISTOGRAM_BINS, 0, "iterations", 0.0f, FLT_MAX, ImVec2(0, 80));
+				ImGui::Text("total iterations: %.2fM", m_Stats.totalIterations * 1e-6);
+				ImGui::Text("interior: %.1f%% late escapes: %.3f%%", m_Stats.interiorFraction * 100.0f, m_Stats.lateEscapeFraction * 100.0f);
+				ImGui::Text("tile imbalance: %.2f", m_Stats.tileImbalance);
+			}
+		}
+
+		static const char* backends[] = { "CPU", "OpenCL" };
+		int backend = (int)m_Backend;
+		if (ImGui::Combo("backend", &backend, backends, 2)) {
+			if (backend == (int)Backend::OpenCL && !m_clMandelbrot) m_clMandelbrot = new clMandelbrot(WIDTH, HEIGHT);
+			m_Backend = (Backend)backend;
+		}
+
+		if (m_Backend == Backend::CPU) {
+			static const char* modes[] = { "escape time", "newton", "lyapunov", "custom" };
+			if (ImGui::Combo("fractal", (int*)&m_Mode, modes, 4) && m_Mode == FractalMode::Custom && !m_Jit.IsReady() && !m_Jit.IsPending()) m_Jit.Compile(m_JitText);
+		}
+
+		if (m_Backend == Backend::CPU && m_Mode == FractalMode::Newton) {
+			ImGui::InputText("p(z)", m_NewtonText, sizeof(m_NewtonText));
+			ImGui::SameLine();
+			if (ImGui::Button("compile")) m_Newton.Parse(m_NewtonText);
+			ImGui::Text("current: %s (%i roots)", m_Newton.GetText().c_str(), m_Newton.GetDegree());
+		}
+		else if (m_Backend == Backend::CPU && m_Mode == FractalMode::Lyapunov) {
+			ImGui::InputText("sequence", m_LyapunovText, sizeof(m_LyapunovText));
+			ImGui::SameLine();
+			if (ImGui::Button("apply")) {
+				if (IsValidSequence(m_LyapunovText)) snprintf(m_Lyapunov.sequence, sizeof(m_Lyapunov.sequence), "%s", m_LyapunovText);
+				else std::cerr << "Sequence " << m_LyapunovText << " is not 1 to " << LYAPUNOV_MAX_SEQUENCE << " letters A and B" << std::endl;
+			}
+			ImGui::SliderInt("warm-up", &m_Lyapunov.warmup, 0, 1024);
+			ImGui::SliderInt("steps", &m_Lyapunov.iterations, 16, 4096);
+			ImGui::Checkbox("table kernel", &m_Lyapunov.forceTable);
+			ImGui::Text("current: %s (%s)", m_Lyapunov.sequence, HasCompiledKernel(m_Lyapunov.sequence) && !m_Lyapunov.forceTable ? "compiled" : "table");
+		}
+		else if (m_Backend == Backend::CPU && m_Mode == FractalMode::Custom) {
+			ImGui::InputText("z =", m_JitText, sizeof(m_JitText));
+			ImGui::SameLine();
+			if (ImGui::Button("compile")) m_Jit.Compile(m_JitText);
+			if (m_Jit.IsReady()) ImGui::Text("current: z = %s (%s %.1f ms)", m_Jit.GetText().c_str(), m_Jit.WasCached() ? "cached" : "compiled", m_Jit.GetCompileTime());
+			else ImGui::Text("no formula compiled, showing the built-in formula");
+			if (m_Jit.IsPending()) ImGui::Text("compiling...");
+			else if (!m_Jit.GetFailedText().empty()) ImGui::Text("z = %s failed to compile, see the log", m_Jit.GetFailedText().c_str());
+			ImGui::Checkbox("julia", &m_Formula.julia);
+			if (m_Formula.julia) ImGui::DragScalarN("c", ImGuiDataType_Double, m_Formula.juliaC, 2, 0.001f);
+		}
+		else if (m_Backend == Backend::CPU) {
+			const char* formulas[(int)FormulaType::Count];
+			for (int f = 0; f < (int)FormulaType::Count; f++) formulas[f] = GetFormulaName((FormulaType)f);
+			ImGui::Combo("formula", (int*)&m_Formula.type, formulas, (int)FormulaType::Count);
+			ImGui::Checkbox("julia", &m_Formula.julia);
+			if (m_Formula.julia) ImGui::DragScalarN("c", ImGuiDataType_Double, m_Formula.juliaC, 2, 0.001f);
+
+			if (IsMandelbrot()) {
+				static const char* cpuKernels[] = { "escape time", "distance estimation" };
+				ImGui::Combo("cpu kernel", (int*)&m_CpuKernel, cpuKernels, 2);
+				if (m_CpuKernel == CpuKernel::DistanceEstimate) ImGui::SliderFloat("outline thickness", &m_OutlineThickness, 0.25f, 16.0f);
+				else {
+					ImGui::Checkbox("interior skip", &m_SkipInterior);
+					if (m_SkipInterior) ImGui::Text("skipped: %.1f%% (%u tests)", m_InteriorStats.skippedFraction * 100.0f, m_InteriorStats.tests);
+				}
+			}
+		}
+
+		if (m_Backend == Backend::OpenCL) {
+			clMandelbrotSettings& settings = m_clMandelbrot->GetSettings();
+			if (!adaptive.enabled) {
+				// Every cap is a program variant of its own, request it only once the slider is released.
+				int iterations = m_EditedIterations ? m_EditedIterations : settings.maxIterations;
+				if (ImGui::SliderInt("iterations", &iterations, 16, 4096)) m_EditedIterations = iterations;
+				if (ImGui::IsItemDeactivatedAfterEdit()) settings.maxIterations = iterations, m_EditedIterations = 0;
+			}
+			ImGui::Checkbox("double precision", &settings.doublePrecision);
+			static const char* formulas[] = { "Mandelbrot", "Burning Ship", "Tricorn" };
+			ImGui::Combo("formula", &settings.formula, formulas, 3);
+			if (m_clMandelbrot->IsVariantPending()) ImGui::Text("building variant...");
+			else if (!m_clMandelbrot->GetFailedVariant().empty()) ImGui::Text("variant failed to build, see the log");
+
+			static const char* kernelModes[] = { "NDRange", "persistent" };
+			ImGui::Combo("kernel", (int*)&settings.kernelMode, kernelModes, 2);
+			if (settings.kernelMode == KernelMode::Persistent) ImGui::SliderInt("batch size", &settings.batchSize, 1, 64);
+			ImGui::Text("avg kernel: NDRange %.2f persistent %.2f", m_AvgKernelTime[0], m_AvgKernelTime[1]);
+
+			static const char* readbacks[] = { "copy", "map" };
+			ImGui::Combo("readback", (int*)&settings.readback, readbacks, 2);
+			const size_t* localSize = m_clMandelbrot->GetLocalSize();
+			ImGui::Text("kernel: %.2f (%zux%zu)", m_clMandelbrot->GetKernelTime(), localSize[0], localSize[1]);
+			if (ImGui::Button("tune work size")) m_clMandelbrot->TuneWorkSize();
+			ImGui::Text("readback: %.2f", m_clMandelbrot->GetReadbackTime());
+			if (ImGui::Button("benchmark readback")) BenchmarkReadback(100);
+			if (m_BenchCopyTime > 0.0) ImGui::Text("copy: %.2f map: %.2f", m_BenchCopyTime, m_BenchMapTime);
+
+			clProfiler& profiler = m_clMandelbrot->GetProfiler();
+			const clFrameStats& stats = profiler.GetFrameStats();
+			ImGui::Text("commands: %i", stats.commands);
+			ImGui::Text("queue latency: %.2f", stats.queueLatency);
+			ImGui::Text("execution: %.2f busy: %.2f overlap: %.2f", stats.execution, stats.busy, stats.overlap);
+			ImGui::Text("span: %.2f", stats.span);
+			if (!profiler.IsCapturing()) {
+				if (ImGui::Button("capture trace")) profiler.StartCapture();
+			}
+			else if (ImGui::Button("stop and export trace")) {
+				profiler.StopCapture();
+				profiler.ExportChromeTrace("opencl_trace.json");
+			}
+		}
 		ImGui::End();
 
 		// Render dear imgui into screen
@@ -4,6 +4,8 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
+#include "FrameTimer.h"
+#include "Trace.h"
 #include "Shader.h"
 
 App::App(uint width, uint height)
@@ -26,15 +28,19 @@ App::~App()
 
 void App::Run()
 {	
+	FrameTimer& timer = FrameTimer::Get();
+	TRACE_THREAD_NAME("main");
 	// Variables for computing time passed per frame.
-	std::chrono::system_clock::time_point tp = std::chrono::system_clock::now();
-	std::chrono::system_clock::time_point tc = std::chrono::system_clock::now();
-	float dt = std::chrono::duration<float>(tc - tp).count() + 0.00001f;
+	std::chrono::steady_clock::time_point tp = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point tc = std::chrono::steady_clock::now();
 
 	do {
+		long long frameStart = timer.Now();
+		TRACE_SCOPE("frame", "frame");
+
 		// Compute the time passed since last loop.
 		float dt = std::chrono::duration<float>(tc - tp).count() + 0.00001f;
-		tp = tc; tc = std::chrono::system_clock::now();
+		tp = tc; tc = std::chrono::steady_clock::now();
 		// Compute the average time (smoothes out over time).
 		m_AvgTime = m_AvgTime * 0.975f + dt * 0.025f;
 
@@ -42,21 +48,44 @@ void App::Run()
 		glClear(GL_COLOR_BUFFER_BIT);
 
 		// App logic.
-		Tick(dt);
-		Draw(dt);
-
-
-		m_RenderSurface->Draw();
-		RenderGUI(dt);
-
-
-		glfwSwapBuffers(m_Window);
+		{
+			ScopedTimer t(FramePhase::Tick);
+			TRACE_SCOPE("frame", "tick");
+			Tick(dt);
+		}
+		{
+			// Draw uploads the frame to the render surface.
+			ScopedTimer t(FramePhase::Upload);
+			Draw(dt);
+		}
+
+		{
+			ScopedTimer t(FramePhase::Draw);
+			m_RenderSurface->Draw();
+		}
+		{
+			ScopedTimer t(FramePhase::GUI);
+			TRACE_SCOPE("frame", "gui");
+			RenderGUI(dt);
+		}
+
+		{
+			ScopedTimer t(FramePhase::Swap);
+			TRACE_SCOPE("frame", "swap");
+			glfwSwapBuffers(m_Window);
+		}
 		glfwPollEvents();
 
 		// Update the InputHelper.
 		m_InputHelper->Update();
 
+		timer.Record(FramePhase::Frame, frameStart, timer.Now());
+		timer.EndFrame();
 	} while (!glfwWindowShouldClose(m_Window) && !m_InputHelper->IsKeyPressed(Key::Escape));
+
+	// Dump the recent frame timings for offline analysis.
+	timer.ExportCSV("frame_timings.csv");
+	timer.ExportChromeTrace("frame_timings.json");
 }
 
 void App::InitGLFW()
@@ -0,0 +1,51 @@
+#include "Camera.h"
+#include <algorithm>
+#include <cmath>
+
+/* Rotation per pixel of mouse movement (in radians). */
+#define CAMERA_ROTATE_SPEED 0.005f
+
+Camera::Camera(glm::vec3 target, float distance, float fov) : m_Target(target), m_Distance(distance), m_Fov(fov) {
+	UpdateBasis();
+}
+
+bool Camera::Update(InputHelper& input, float dt) {
+	bool moved = false;
+	if (input.MouseLeftButtonDown()) {
+		glm::vec2 movement = input.GetCursorMovement();
+		if (movement.x != 0.0f || movement.y != 0.0f) {
+			m_Yaw -= movement.x * CAMERA_ROTATE_SPEED;
+			// Stay clear of the poles, the basis is built from the vertical axis.
+			m_Pitch = std::min(std::max(m_Pitch + movement.y * CAMERA_ROTATE_SPEED, -1.5f), 1.5f);
+			moved = true;
+		}
+	}
+	if (input.IsKeyDown(Key::W)) SetDistance(m_Distance * std::exp(-dt)), moved = true;
+	if (input.IsKeyDown(Key::S)) SetDistance(m_Distance * std::exp(dt)), moved = true;
+
+	if (moved) UpdateBasis();
+	return moved;
+}
+
+glm::vec3 Camera::GetRayDirection(float x, float y, uint width, uint height) const {
+	float tanHalfFov = std::tan(glm::radians(m_Fov) * 0.5f);
+	float sx = (2.0f * x / width - 1.0f) * tanHalfFov * width / height;
+	float sy = (2.0f * y / height - 1.0f) * tanHalfFov;
+	return glm::normalize(m_Forward + sx * m_Right + sy * m_Up);
+}
+
+float Camera::GetPixelAngle(uint height) const {
+	return 2.0f * std::tan(glm::radians(m_Fov) * 0.5f) / height;
+}
+
+void Camera::SetDistance(float distance) {
+	m_Distance = std::max(distance, 1e-3f);
+	UpdateBasis();
+}
+
+void Camera::UpdateBasis() {
+	m_Position = m_Target + m_Distance * glm::vec3(std::cos(m_Pitch) * std::sin(m_Yaw), std::sin(m_Pitch), std::cos(m_Pitch) * std::cos(m_Yaw));
+	m_Forward = glm::normalize(m_Target - m_Position);
+	m_Right = glm::normalize(glm::cross(m_Forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+	m_Up = glm::cross(m_Right, m_Forward);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "incl.h"
+#include "InputHelper.h"
+
+/** Camera orbiting a target point. Dragging with the left mouse button rotates it around the target, W and S move it
+* closer and further away.
+*/
+class Camera {
+
+public:
+	/** Places the camera.
+	* @param[in] target		Point the camera orbits and looks at.
+	* @param[in] distance		Distance to the target.
+	* @param[in] fov			Vertical field of view (in degrees).
+	*/
+	Camera(glm::vec3 target = glm::vec3(0.0f), float distance = 3.0f, float fov = 45.0f);
+
+	/** Applies the mouse and keyboard input of a frame.
+	* @param[in] input		Input of the window.
+	* @param[in] dt			Time since the last frame.
+	* @return				True if the camera moved.
+	*/
+	bool Update(InputHelper& input, float dt);
+
+	/** Direction of the ray through a point of the image, row 0 is the bottom row.
+	* @param[in] x, y			Position in pixels, pixel centers lie at + 0.5.
+	* @param[in] width		Image width.
+	* @param[in] height		Image height.
+	* @return				Normalized direction.
+	*/
+	glm::vec3 GetRayDirection(float x, float y, uint width, uint height) const;
+
+	glm::vec3 GetPosition() const { return m_Position; }
+	glm::vec3 GetForward() const { return m_Forward; }
+	/** Angle between the rays through neighbouring pixels (in radians), for an image of the given height. */
+	float GetPixelAngle(uint height) const;
+
+	float GetDistance() const { return m_Distance; }
+	void SetDistance(float distance);
+
+private:
+	glm::vec3 m_Target;
+	/* Rotation around the vertical axis and elevation (in radians). */
+	float m_Yaw = 0.0f, m_Pitch = 0.3f;
+	float m_Distance, m_Fov;
+	glm::vec3 m_Position, m_Forward, m_Right, m_Up;
+
+	/** Recomputes the position and basis from the orbit parameters. */
+	void UpdateBasis();
+};
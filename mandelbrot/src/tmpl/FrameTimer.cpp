@@ -0,0 +1,118 @@
+#include "FrameTimer.h"
+#include <algorithm>
+#include <fstream>
+
+/* Number of frames between refreshing the statistics. */
+#define STATS_INTERVAL 30
+
+void PhaseRing::Read(std::vector<PhaseSample>& samples) const {
+	size_t head = m_Head.load(std::memory_order_acquire);
+	size_t count = std::min(head, (size_t)Capacity);
+	for (size_t i = head - count; i < head; i++) samples.push_back(m_Samples[i & (Capacity - 1)]);
+}
+
+FrameTimer& FrameTimer::Get() {
+	static FrameTimer timer;
+	return timer;
+}
+
+FrameTimer::FrameTimer() : m_Origin(std::chrono::steady_clock::now()) {}
+
+FrameTimer::~FrameTimer() {
+	for (PhaseRing* ring : m_Rings) delete ring;
+}
+
+PhaseRing& FrameTimer::GetThreadRing() {
+	thread_local PhaseRing* ring = nullptr;
+	if (!ring) {
+		ring = new PhaseRing();
+		std::lock_guard<std::mutex> lock(m_RingsMutex);
+		ring->threadIndex = (uint)m_Rings.size();
+		m_Rings.push_back(ring);
+	}
+	return *ring;
+}
+
+std::vector<PhaseSample> FrameTimer::ReadSamples(std::vector<uint>* threads) {
+	std::vector<PhaseSample> samples;
+	std::lock_guard<std::mutex> lock(m_RingsMutex);
+	for (const PhaseRing* ring : m_Rings) {
+		ring->Read(samples);
+		if (threads) threads->resize(samples.size(), ring->threadIndex);
+	}
+	return samples;
+}
+
+void FrameTimer::EndFrame() {
+	uint frame = m_Frame.fetch_add(1, std::memory_order_relaxed) + 1;
+	if (frame % STATS_INTERVAL != 0) return;
+
+	std::vector<double> durations[(int)FramePhase::Count];
+	for (const PhaseSample& s : ReadSamples())
+		durations[(int)s.phase].push_back((s.end - s.start) * 1e-6);
+
+	for (int p = 0; p < (int)FramePhase::Count; p++) {
+		std::vector<double>& d = durations[p];
+		PhaseStats& stats = m_Stats[p];
+		stats = PhaseStats();
+		if (d.empty()) continue;
+
+		std::sort(d.begin(), d.end());
+		auto percentile = [&d](double q) { return d[std::min(d.size() - 1, (size_t)(q * d.size()))]; };
+		stats.samples = (int)d.size();
+		stats.p50 = percentile(0.50);
+		stats.p95 = percentile(0.95);
+		stats.p99 = percentile(0.99);
+		stats.max = d.back();
+	}
+}
+
+const char* FrameTimer::GetName(FramePhase phase) {
+	static const char* names[(int)FramePhase::Count] = { "frame", "tick", "colorize", "upload", "draw", "gui", "swap" };
+	return names[(int)phase];
+}
+
+bool FrameTimer::ExportCSV(const char* path) {
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Could not write " << path << "." << std::endl;
+		return false;
+	}
+
+	std::vector<uint> threads;
+	std::vector<PhaseSample> samples = ReadSamples(&threads);
+	file << "thread,frame,phase,start_ms,duration_ms\n";
+	file.precision(6);
+	file << std::fixed;
+	for (size_t i = 0; i < samples.size(); i++) {
+		const PhaseSample& s = samples[i];
+		file << threads[i] << "," << s.frame << "," << GetName(s.phase) << "," << s.start * 1e-6 << "," << (s.end - s.start) * 1e-6 << "\n";
+	}
+
+	printf("Wrote %zu frame timings to %s\n", samples.size(), path);
+	return true;
+}
+
+bool FrameTimer::ExportChromeTrace(const char* path) {
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Could not write trace " << path << "." << std::endl;
+		return false;
+	}
+
+	std::vector<uint> threads;
+	std::vector<PhaseSample> samples = ReadSamples(&threads);
+	// Timestamps in us, one track per thread.
+	file << "{\"traceEvents\":[";
+	file.precision(3);
+	file << std::fixed;
+	for (size_t i = 0; i < samples.size(); i++) {
+		const PhaseSample& s = samples[i];
+		file << (i ? ",\n" : "\n") << "{\"name\":\"" << GetName(s.phase) << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":0,\"tid\":" << threads[i]
+			<< ",\"ts\":" << s.start * 1e-3 << ",\"dur\":" << (s.end - s.start) * 1e-3 << ",\"args\":{\"frame\":" << s.frame << "}}";
+	}
+	file << "\n]}\n";
+
+	printf("Wrote %zu frame timings to %s\n", samples.size(), path);
+	return true;
+}
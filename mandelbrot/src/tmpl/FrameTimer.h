@@ -0,0 +1,131 @@
+#pragma once
+#include "incl.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+/** Phases of a frame that are timed separately. */
+enum class FramePhase : int {
+	Frame = 0,
+	Tick,
+	Colorize,
+	Upload,
+	Draw,
+	GUI,
+	Swap,
+	Count
+};
+
+/** Timing of a single phase, in ns since the start of the application. */
+struct PhaseSample {
+	FramePhase phase;
+	uint frame;
+	long long start, end;
+};
+
+/** Percentiles of the recent samples of a phase, in ms. */
+struct PhaseStats {
+	int samples = 0;
+	double p50 = 0.0, p95 = 0.0, p99 = 0.0;
+	double max = 0.0;
+};
+
+/** Fixed-size ring of samples written by a single thread. Writing is wait-free; readers may see a sample that is being overwritten,
+* which is acceptable for statistics.
+*/
+class PhaseRing {
+
+public:
+	static const size_t Capacity = 1 << 12;
+
+	/** Appends a sample, overwriting the oldest one when the ring is full. Must only be called by the owning thread. */
+	inline void Push(const PhaseSample& sample) {
+		size_t head = m_Head.load(std::memory_order_relaxed);
+		m_Samples[head & (Capacity - 1)] = sample;
+		m_Head.store(head + 1, std::memory_order_release);
+	}
+	/** Appends the samples currently in the ring, oldest first.
+	* @param[out] samples		Vector to append the samples to.
+	*/
+	void Read(std::vector<PhaseSample>& samples) const;
+
+	/** Thread that owns the ring, for the trace export. */
+	uint threadIndex = 0;
+
+private:
+	PhaseSample m_Samples[Capacity];
+	std::atomic<size_t> m_Head{ 0 };
+};
+
+/** Collects per-phase frame timings from every thread on a monotonic clock. */
+class FrameTimer {
+
+public:
+	/** Retrieves the timer of the application. */
+	static FrameTimer& Get();
+	~FrameTimer();
+
+	/** Nanoseconds since the timer was created, on std::chrono::steady_clock. */
+	inline long long Now() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Origin).count();
+	}
+
+	/** Records a phase on the calling thread.
+	* @param[in] phase			Timed phase.
+	* @param[in] start			Start time, from Now().
+	* @param[in] end			End time, from Now().
+	*/
+	inline void Record(FramePhase phase, long long start, long long end) {
+		GetThreadRing().Push({ phase, m_Frame.load(std::memory_order_relaxed), start, end });
+	}
+
+	/** Ends the current frame and refreshes the statistics every few frames. Called once per frame by the main-loop. */
+	void EndFrame();
+	/** Retrieves the statistics of a phase over the recent frames. */
+	const PhaseStats& GetStats(FramePhase phase) const { return m_Stats[(int)phase]; }
+	/** Retrieves the display name of a phase. */
+	static const char* GetName(FramePhase phase);
+
+	/** Writes the recent samples as CSV with the columns thread, frame, phase, start_ms, duration_ms.
+	* @param[in] path			Output file path.
+	* @returns					true if the file was written.
+	*/
+	bool ExportCSV(const char* path);
+	/** Writes the recent samples as Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+	* @param[in] path			Output file path.
+	* @returns					true if the file was written.
+	*/
+	bool ExportChromeTrace(const char* path);
+
+private:
+	FrameTimer();
+
+	/** Retrieves the ring of the calling thread, registering it on first use. */
+	PhaseRing& GetThreadRing();
+	/** Gathers the samples of all threads. */
+	std::vector<PhaseSample> ReadSamples(std::vector<uint>* threads = nullptr);
+
+	std::chrono::steady_clock::time_point m_Origin;
+	std::atomic<uint> m_Frame{ 0 };
+
+	/** Rings of all threads that recorded a phase, only locked when a thread registers or the rings are read. */
+	std::mutex m_RingsMutex;
+	std::vector<PhaseRing*> m_Rings;
+
+	PhaseStats m_Stats[(int)FramePhase::Count];
+};
+
+/** Records the time between its construction and destruction as a phase of the current frame. */
+class ScopedTimer {
+
+public:
+	ScopedTimer(FramePhase phase) : m_Phase(phase), m_Start(FrameTimer::Get().Now()) {}
+	~ScopedTimer() {
+		FrameTimer& timer = FrameTimer::Get();
+		timer.Record(m_Phase, m_Start, timer.Now());
+	}
+
+private:
+	FramePhase m_Phase;
+	long long m_Start;
+};
@@ -0,0 +1,117 @@
+#include "PerfCounters.h"
+#include <omp.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define EVENTS (int)PerfEvent::Count
+
+/** Opens a counter for an event on the calling thread, -1 if it is not supported. */
+static int OpenEvent(PerfEvent e) {
+	perf_event_attr attr = {};
+	attr.size = sizeof(attr);
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	switch (e) {
+	case PerfEvent::Cycles:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CPU_CYCLES;
+		break;
+	case PerfEvent::Instructions:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+		break;
+	case PerfEvent::BranchMisses:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+		break;
+	case PerfEvent::L1DMisses:
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	case PerfEvent::LLCMisses:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		break;
+	case PerfEvent::LicenseStalls:
+		// Raw Intel event (event 0x28, umask 0x40), the encoding means something else on other vendors.
+		if (!__builtin_cpu_is("intel")) return -1;
+		attr.type = PERF_TYPE_RAW;
+		attr.config = 0x4028;
+		break;
+	default:
+		return -1;
+	}
+
+	// Count the calling thread on any CPU.
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+PerfCounters::PerfCounters() {
+	int threads = omp_get_max_threads();
+	m_Descriptors.assign((size_t)threads * EVENTS, -1);
+
+	// perf counters follow a thread, so every pool thread opens its own. OpenMP reuses the same pool for later regions.
+#pragma omp parallel num_threads(threads)
+	{
+		int t = omp_get_thread_num();
+		for (int e = 0; e < EVENTS; e++) m_Descriptors[t * EVENTS + e] = OpenEvent((PerfEvent)e);
+	}
+
+	m_Available = m_Descriptors[(int)PerfEvent::Cycles] >= 0;
+	if (!m_Available) printf("Hardware counters unavailable, check /proc/sys/kernel/perf_event_paranoid.\n");
+}
+
+PerfCounters::~PerfCounters() {
+	for (int fd : m_Descriptors)
+		if (fd >= 0) close(fd);
+}
+
+void PerfCounters::Start() {
+	for (int fd : m_Descriptors)
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+}
+
+PerfSample PerfCounters::Stop() {
+	for (int fd : m_Descriptors)
+		if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+	PerfSample sample;
+	for (size_t i = 0; i < m_Descriptors.size(); i++) {
+		int fd = m_Descriptors[i], e = (int)(i % EVENTS);
+		if (fd < 0) continue;
+
+		// value, time enabled, time running.
+		unsigned long long data[3];
+		if (read(fd, data, sizeof(data)) != sizeof(data)) continue;
+		double scale = data[2] ? (double)data[1] / (double)data[2] : 0.0;
+		sample.values[e] += (unsigned long long)(data[0] * scale);
+		sample.valid[e] = true;
+	}
+	return sample;
+}
+
+#else
+
+PerfCounters::PerfCounters() {
+	printf("Hardware counters are only read on Linux.\n");
+}
+PerfCounters::~PerfCounters() {}
+void PerfCounters::Start() {}
+PerfSample PerfCounters::Stop() { return PerfSample(); }
+
+#endif
+
+const char* PerfCounters::GetName(PerfEvent e) {
+	static const char* names[(int)PerfEvent::Count] = { "cycles", "instructions", "branch misses", "L1D misses", "LLC misses", "licence stalls" };
+	return names[(int)e];
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "incl.h"
+
+/** Hardware events counted around a compute phase. */
+enum class PerfEvent : int {
+	Cycles = 0,
+	Instructions,
+	BranchMisses,
+	L1DMisses,
+	LLCMisses,
+	/** Cycles the core was throttled while switching AVX frequency licence (Intel CORE_POWER.THROTTLE). */
+	LicenseStalls,
+	Count
+};
+
+/** Counter values of a measured interval, summed over all threads. Events that could not be opened are not valid. */
+struct PerfSample {
+	unsigned long long values[(int)PerfEvent::Count] = {};
+	bool valid[(int)PerfEvent::Count] = {};
+
+	inline double Get(PerfEvent e) const { return (double)values[(int)e]; }
+	inline bool Has(PerfEvent e) const { return valid[(int)e]; }
+	/** Instructions per cycle, 0 if unavailable. */
+	inline double GetIPC() const { return Has(PerfEvent::Cycles) && Has(PerfEvent::Instructions) && values[0] ? Get(PerfEvent::Instructions) / Get(PerfEvent::Cycles) : 0.0; }
+	/** Events per pixel, 0 if unavailable. */
+	inline double GetPerPixel(PerfEvent e, size_t pixels) const { return Has(e) && pixels ? Get(e) / pixels : 0.0; }
+};
+
+/** Hardware performance counters of the calling thread and the OpenMP worker threads, read through perf_event_open.
+* Only available on Linux, and only when perf_event_paranoid allows user-space counting; elsewhere IsAvailable() returns false.
+*/
+class PerfCounters {
+
+public:
+	/** Opens the counters on the calling thread and on every thread of the OpenMP pool. */
+	PerfCounters();
+	~PerfCounters();
+
+	/** Checks whether at least the cycle counter could be opened. */
+	bool IsAvailable() const { return m_Available; }
+
+	/** Resets and enables all counters. */
+	void Start();
+	/** Disables all counters and reads their values.
+	* @returns					Counts since Start, scaled up when the kernel multiplexed the counters.
+	*/
+	PerfSample Stop();
+
+	/** Retrieves the display name of an event. */
+	static const char* GetName(PerfEvent e);
+
+private:
+	/** File descriptors per thread and event, -1 if the event is unavailable. */
+	std::vector<int> m_Descriptors;
+	bool m_Available = false;
+};
@@ -1,4 +1,5 @@
 #include "surface.h"
+#include "Trace.h"
 
 #define QUAD_RENDERING
 
@@ -47,6 +48,7 @@ Surface::~Surface() {
 }
 
 void Surface::Draw() {
+	TRACE_SCOPE("gl", "draw");
 
 #ifdef QUAD_RENDERING
 	/** Render via a texture quad.*/
@@ -76,6 +78,7 @@ void Surface::Draw() {
 }
 
 void Surface::PlotPixels(Color* colors) {
+	TRACE_SCOPE("gl", "upload");
 	glBindTexture(GL_TEXTURE_2D, m_RenderTexture);
 	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_Width, m_Height, GL_RGBA, GL_FLOAT, (GLvoid*)colors);
 	glBindTexture(GL_TEXTURE_2D, 0);
@@ -83,6 +86,7 @@ void Surface::PlotPixels(Color* colors) {
 }
 
 void Surface::PlotPixels(Color* colors, uint dx, uint dy, uint width, uint height) {
+	TRACE_SCOPE("gl", "upload");
 	glBindTexture(GL_TEXTURE_2D, m_RenderTexture);
 	glTexSubImage2D(GL_TEXTURE_2D, 0, dx, dy, width, height, GL_RGBA, GL_FLOAT, (GLvoid*)colors);
 	glBindTexture(GL_TEXTURE_2D, 0);
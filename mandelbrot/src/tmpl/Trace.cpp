@@ -0,0 +1,69 @@
+#include "Trace.h"
+#include <fstream>
+
+Tracer& Tracer::Get() {
+	static Tracer tracer;
+	return tracer;
+}
+
+Tracer::~Tracer() {
+	for (TraceBuffer* buffer : m_Buffers) delete buffer;
+}
+
+TraceBuffer& Tracer::GetThreadBuffer() {
+	thread_local TraceBuffer* buffer = nullptr;
+	if (!buffer) {
+		buffer = new TraceBuffer();
+		std::lock_guard<std::mutex> lock(m_BuffersMutex);
+		buffer->threadIndex = (uint)m_Buffers.size();
+		m_Buffers.push_back(buffer);
+	}
+	return *buffer;
+}
+
+void Tracer::SetThreadName(const char* name) {
+	GetThreadBuffer().threadName = name;
+}
+
+void Tracer::StartCapture(size_t maxEventsPerThread) {
+	std::lock_guard<std::mutex> lock(m_BuffersMutex);
+	for (TraceBuffer* buffer : m_Buffers) buffer->events.clear();
+	m_MaxEventsPerThread = maxEventsPerThread;
+	m_Capturing.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::StopCapture() {
+	m_Capturing.store(false, std::memory_order_relaxed);
+}
+
+bool Tracer::ExportChromeTrace(const char* path) {
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Could not write trace " << path << "." << std::endl;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_BuffersMutex);
+	size_t count = 0;
+	// One track per thread, timestamps in us.
+	file << "{\"traceEvents\":[\n";
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"mandelbrot\"}}";
+	file.precision(3);
+	file << std::fixed;
+	for (const TraceBuffer* buffer : m_Buffers) {
+		std::string name = buffer->threadName.empty() ? "thread " + std::to_string(buffer->threadIndex) : buffer->threadName;
+		file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->threadIndex << ",\"args\":{\"name\":\"" << name << "\"}}";
+
+		for (const TraceEvent& e : buffer->events) {
+			file << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->threadIndex
+				<< ",\"ts\":" << e.start * 1e-3 << ",\"dur\":" << (e.end - e.start) * 1e-3;
+			if (e.arg >= 0) file << ",\"args\":{\"index\":" << e.arg << "}";
+			file << "}";
+		}
+		count += buffer->events.size();
+	}
+	file << "\n]}\n";
+
+	printf("Wrote %zu trace events to %s\n", count, path);
+	return true;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "FrameTimer.h"
+
+/*
+* Tracing of what every thread does within a frame. Remove the define to compile all trace scopes away.
+*/
+#define ENABLE_TRACING
+
+/** A traced interval on a single thread, in ns on the FrameTimer clock. */
+struct TraceEvent {
+	/** Category and name, must be string literals. */
+	const char* category;
+	const char* name;
+	long long start, end;
+	/** Optional argument shown in the trace, e.g. a tile index, -1 if unused. */
+	int arg;
+};
+
+/** Thread-local buffer of trace events. */
+struct TraceBuffer {
+	uint threadIndex = 0;
+	std::string threadName;
+	std::vector<TraceEvent> events;
+};
+
+/** Collects trace events of all threads while a capture is running. Recording only touches thread-local memory. */
+class Tracer {
+
+public:
+	/** Retrieves the tracer of the application. */
+	static Tracer& Get();
+	~Tracer();
+
+	/** Checks whether events are being captured. */
+	inline bool IsCapturing() const { return m_Capturing.load(std::memory_order_relaxed); }
+
+	/** Records an event on the calling thread, ignored when no capture is running. */
+	inline void Record(const char* category, const char* name, long long start, long long end, int arg = -1) {
+		if (!IsCapturing()) return;
+		TraceBuffer& buffer = GetThreadBuffer();
+		if (buffer.events.size() < m_MaxEventsPerThread) buffer.events.push_back({ category, name, start, end, arg });
+	}
+
+	/** Names the calling thread in the trace.
+	* @param[in] name			Thread name.
+	*/
+	void SetThreadName(const char* name);
+
+	/** Discards previously captured events and starts capturing.
+	* @param[in] maxEventsPerThread	Maximum number of events kept per thread, later events are dropped.
+	*/
+	void StartCapture(size_t maxEventsPerThread = 1 << 18);
+	/** Stops capturing, threads may still finish the events they are recording. */
+	void StopCapture();
+	/** Writes the captured events as Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+	* <b>NOTE:</b> only call this when no thread is recording, e.g. between frames after StopCapture.
+	* @param[in] path			Output file path.
+	* @returns					true if the file was written.
+	*/
+	bool ExportChromeTrace(const char* path);
+
+private:
+	Tracer() = default;
+
+	/** Retrieves the buffer of the calling thread, registering it on first use. */
+	TraceBuffer& GetThreadBuffer();
+
+	std::atomic<bool> m_Capturing{ false };
+	size_t m_MaxEventsPerThread = 0;
+
+	std::mutex m_BuffersMutex;
+	std::vector<TraceBuffer*> m_Buffers;
+};
+
+/** Records the time between its construction and destruction as a trace event. */
+class TraceScope {
+
+public:
+	TraceScope(const char* category, const char* name, int arg = -1)
+		: m_Category(category), m_Name(name), m_Arg(arg), m_Start(Tracer::Get().IsCapturing() ? FrameTimer::Get().Now() : -1) {}
+	~TraceScope() {
+		if (m_Start >= 0) Tracer::Get().Record(m_Category, m_Name, m_Start, FrameTimer::Get().Now(), m_Arg);
+	}
+
+private:
+	const char* m_Category;
+	const char* m_Name;
+	int m_Arg;
+	long long m_Start;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#ifdef ENABLE_TRACING
+/** Traces the enclosing scope. */
+#define TRACE_SCOPE(category, name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(category, name)
+/** Traces the enclosing scope with an integer argument. */
+#define TRACE_SCOPE_ARG(category, name, arg) TraceScope TRACE_CONCAT(traceScope, __LINE__)(category, name, arg)
+/** Names the calling thread in the trace. */
+#define TRACE_THREAD_NAME(name) Tracer::Get().SetThreadName(name)
+#else
+#define TRACE_SCOPE(category, name)
+#define TRACE_SCOPE_ARG(category, name, arg)
+#define TRACE_THREAD_NAME(name)
+#endif
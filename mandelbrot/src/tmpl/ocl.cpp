@@ -1,10 +1,18 @@
 #include "ocl.h"
 #include "incl.h"
+#include "Trace.h"
 
 #include <CL/cl_gl.h>
+#ifdef _WIN32
 #include <Windows.h>
+#endif
+#include <stdexcept>
 #include <string>
+#include <malloc.h>
 #include <glew/glew.h>
+#ifndef _WIN32
+#include <GL/glx.h>
+#endif
 
 // Forward declaration.
 void FATAL_ERROR(const char* format, ...);
@@ -165,6 +173,14 @@ void clContext::GetPlatformAndDevice() {
 				}
 	}
 
+	// Fall back to any other device (integrated GPU or CPU runtime).
+	for (cl_uint i = 0; i < platformCount; i++) {
+		if (clGetDeviceIDs(platforms[i], CL_DEVICE_TYPE_ALL, 1, &m_DeviceID, NULL) == CL_SUCCESS) {
+			m_PlatformID = platforms[i];
+			return;
+		}
+	}
+
 	free(platforms);
 	free(pInfo);
 
@@ -173,8 +189,13 @@ void clContext::GetPlatformAndDevice() {
 
 void clContext::CreateContext(bool glInteropEnabled) {
 	cl_context_properties properties[]{
+#ifdef _WIN32
 			CL_GL_CONTEXT_KHR, (cl_context_properties)wglGetCurrentContext(),
 				CL_WGL_HDC_KHR, (cl_context_properties)wglGetCurrentDC(),
+#else
+			CL_GL_CONTEXT_KHR, (cl_context_properties)glXGetCurrentContext(),
+				CL_GLX_DISPLAY_KHR, (cl_context_properties)glXGetCurrentDisplay(),
+#endif
 				CL_CONTEXT_PLATFORM, (cl_context_properties)m_PlatformID,
 				0
 	};
@@ -184,6 +205,38 @@ void clContext::CreateContext(bool glInteropEnabled) {
 	CL_ERROR(errorCode, "could not create cl_context");
 }
 
+bool clContext::HasHostUnifiedMemory() {
+	cl_bool unified = CL_FALSE;
+	clGetDeviceInfo(m_DeviceID, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(unified), &unified, NULL);
+	return unified || IsCPUDevice();
+}
+
+bool clContext::IsCPUDevice() {
+	cl_device_type deviceType = 0;
+	clGetDeviceInfo(m_DeviceID, CL_DEVICE_TYPE, sizeof(deviceType), &deviceType, NULL);
+	return deviceType & CL_DEVICE_TYPE_CPU;
+}
+
+unsigned int clContext::GetComputeUnits() {
+	cl_uint coreCount = 1;
+	clGetDeviceInfo(m_DeviceID, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(coreCount), &coreCount, NULL);
+	return coreCount;
+}
+
+std::string clContext::GetDeviceName() {
+	char name[256];
+	clGetDeviceInfo(m_DeviceID, CL_DEVICE_NAME, sizeof(name), name, NULL);
+	return std::string(name);
+}
+
+size_t clContext::GetHostPtrAlignment() {
+	cl_uint baseAddrAlign = 0; // In bits.
+	clGetDeviceInfo(m_DeviceID, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(baseAddrAlign), &baseAddrAlign, NULL);
+	// Intel runtimes only avoid the copy for page aligned memory.
+	size_t alignment = baseAddrAlign / 8;
+	return alignment > 4096 ? alignment : 4096;
+}
+
 void clContext::PrintDeviceInfo() {
 	char vendor[256];				// Vendor.
 	char name[256];					// Name.
@@ -261,10 +314,15 @@ void clContext::PrintDeviceInfo() {
 #pragma endregion
 
 #pragma region Program
-clProgram::clProgram(clContext* context, const char* path) {
+clProgram::clProgram(clContext* context, const char* path, const char* defines) {
 
 	CreateProgram(context, path);
-	BuildProgram(context);
+	// The destructor does not run when the constructor throws.
+	try { BuildProgram(context, defines); }
+	catch (...) {
+		clReleaseProgram(m_Program);
+		throw;
+	}
 }
 
 clProgram::~clProgram() {
@@ -286,12 +344,13 @@ void clProgram::CreateProgram(clContext* context, const char* path) {
 	CL_ERROR(errorCode, "could not create cl program.");
 }
 
-void clProgram::BuildProgram(clContext* context) {
+void clProgram::BuildProgram(clContext* context, const char* defines) {
+	TRACE_SCOPE("opencl", "clBuildProgram");
+	std::string options = "-cl-fast-relaxed-math -cl-mad-enable -cl-denorms-are-zero -cl-no-signed-zeros -cl-unsafe-math-optimizations -cl-finite-math-only ";
+	options.append(defines);
+
 	cl_int buildStatus =
-		clBuildProgram(m_Program, 1, &context->GetDeviceID(),
-			"-I \"../../../core/src/rendering\" -cl-fast-relaxed-math -cl-mad-enable -cl-denorms-are-zero -cl-no-signed-zeros -cl-unsafe-math-optimizations -cl-finite-math-only",
-			NULL, NULL
-		);
+		clBuildProgram(m_Program, 1, &context->GetDeviceID(), options.c_str(), NULL, NULL);
 
 	// Check for errors during building.
 	if (buildStatus != CL_SUCCESS) {
@@ -299,9 +358,9 @@ void clProgram::BuildProgram(clContext* context) {
 		log[0] = 0;
 		clGetProgramBuildInfo(m_Program, context->GetDeviceID(), CL_PROGRAM_BUILD_LOG, 100 * 1024, log, NULL);
 		log[2048] = 0; // Truncate very long logs.
-		printf("\n%s\n", log);
-
-		throw std::exception();
+		std::runtime_error error(log);
+		delete[] log;
+		throw error;
 	}
 }
 
@@ -396,10 +455,12 @@ clCommandQueue::~clCommandQueue() {
 }
 
 void clCommandQueue::Synchronize() {
+	TRACE_SCOPE("opencl", "clFinish");
 	CL_ERROR(clFinish(m_Queue), "Failed to synchronize the command queue.");
 }
 
 void clCommandQueue::Flush() {
+	TRACE_SCOPE("opencl", "clFlush");
 	CL_ERROR(clFlush(m_Queue), "Failed to flush the command queue.");
 }
 #pragma endregion
@@ -412,6 +473,21 @@ clBuffer::clBuffer(clContext* context, size_t size, BufferFlags flags) : m_Buffe
 	CL_ERROR(errorCode, "Failed to create buffer.");
 }
 
+clBuffer::clBuffer(clContext* context, size_t size, BufferFlags flags, HostMemory hostMemory) : m_BufferSize(size) {
+
+	if (hostMemory == HostMemory::USE_HOST_PTR) {
+		// Size should be a multiple of the cache line size to be used without copying.
+		size_t allocSize = (size + 63) & ~(size_t)63;
+		m_HostPtr = _aligned_malloc(allocSize, context->GetHostPtrAlignment());
+		if (!m_HostPtr) FATAL_ERROR("Failed to allocate aligned host memory.");
+		size = allocSize;
+	}
+
+	cl_int errorCode;
+	m_Buffer = clCreateBuffer(context->GetContext(), cl_mem_flags(flags) | cl_mem_flags(hostMemory), size, m_HostPtr, &errorCode);
+	CL_ERROR(errorCode, "Failed to create host-visible buffer.");
+}
+
 clBuffer::clBuffer(clContext* context, unsigned int glTexture) : m_BufferSize(0) {
 	cl_int errorCode;
 	m_Buffer = clCreateFromGLTexture(context->GetContext(), CL_MEM_WRITE_ONLY, GL_TEXTURE_2D, 0, glTexture, &errorCode);
@@ -448,9 +524,11 @@ clBuffer::clBuffer(clContext* context, clCommandQueue* queue, cl_image_format* f
 
 clBuffer::~clBuffer() {
 	CL_ERROR(clReleaseMemObject(m_Buffer), "Failed to release buffer.");
+	if (m_HostPtr) _aligned_free(m_HostPtr);
 }
 
 void clBuffer::CopyToDevice(clCommandQueue* queue, void* src, bool blocking, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueWriteBuffer");
 	CL_ERROR(
 		clEnqueueWriteBuffer(queue->GetCommandQueue(), m_Buffer, blocking, 0, m_BufferSize, src, 0, nullptr, pEvent),
 		"Failed to copy data to device buffer."
@@ -458,6 +536,7 @@ void clBuffer::CopyToDevice(clCommandQueue* queue, void* src, bool blocking, gpu
 }
 
 void clBuffer::CopyToDevice(clCommandQueue* queue, void* src, size_t offset, size_t size, bool blocking, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueWriteBuffer");
 	CL_ERROR(
 		clEnqueueWriteBuffer(queue->GetCommandQueue(), m_Buffer, blocking, offset, size, src, 0, nullptr, pEvent),
 		"Failed to copy data to device buffer."
@@ -465,6 +544,7 @@ void clBuffer::CopyToDevice(clCommandQueue* queue, void* src, size_t offset, siz
 }
 
 void clBuffer::CopyToHost(clCommandQueue* queue, void* dst, bool blocking, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueReadBuffer");
 	CL_ERROR(
 		clEnqueueReadBuffer(queue->GetCommandQueue(), m_Buffer, blocking, 0, m_BufferSize, dst, 0, nullptr, pEvent),
 		"Failed to copy data to device buffer."
@@ -472,13 +552,23 @@ void clBuffer::CopyToHost(clCommandQueue* queue, void* dst, bool blocking, gpu_e
 }
 
 void clBuffer::CopyToHost(clCommandQueue* queue, void* dst, size_t offset, size_t size, bool blocking, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueReadBuffer");
 	CL_ERROR(
 		clEnqueueReadBuffer(queue->GetCommandQueue(), m_Buffer, blocking, offset, size, dst, 0, nullptr, pEvent),
 		"Failed to copy data to device buffer."
 	);
 }
 
+void clBuffer::Fill(clCommandQueue* queue, const void* pattern, size_t patternSize, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueFillBuffer");
+	CL_ERROR(
+		clEnqueueFillBuffer(queue->GetCommandQueue(), m_Buffer, pattern, patternSize, 0, m_BufferSize, 0, nullptr, pEvent),
+		"Failed to fill device buffer."
+	);
+}
+
 void clBuffer::CopyToDeviceImage(clCommandQueue* queue, void* src, bool blocking, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueWriteImage");
 	if (!m_Format || !m_Desc) FATAL_ERROR("clBuffer is not an OpenCL image object (CopyToDeviceImage).");
 
 	static size_t origin[3]{ 0, 0, 0 };
@@ -491,6 +581,7 @@ void clBuffer::CopyToDeviceImage(clCommandQueue* queue, void* src, bool blocking
 }
 
 void clBuffer::CopyToDeviceImage(clCommandQueue* queue, void* src, size_t origin[3], size_t region[3], bool blocking, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueWriteImage");
 	if (!m_Format || !m_Desc) FATAL_ERROR("clBuffer is not an OpenCL image object (CopyToDeviceImage).");
 	CL_ERROR(
 		clEnqueueWriteImage(queue->GetCommandQueue(), m_Buffer, blocking, origin, region, m_Desc->image_row_pitch, m_Desc->image_slice_pitch, src, 0, NULL, pEvent),
@@ -499,6 +590,7 @@ void clBuffer::CopyToDeviceImage(clCommandQueue* queue, void* src, size_t origin
 }
 
 void clBuffer::CopyToHostImage(clCommandQueue* queue, void* dst, bool blocking, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueReadImage");
 	if (!m_Format || !m_Desc) FATAL_ERROR("clBuffer is not an OpenCL image object (CopyToHostImage).");
 
 	static size_t origin[3]{ 0, 0, 0 };
@@ -511,6 +603,7 @@ void clBuffer::CopyToHostImage(clCommandQueue* queue, void* dst, bool blocking,
 }
 
 void clBuffer::CopyToHostImage(clCommandQueue* queue, void* dst, size_t origin[3], size_t region[3], bool blocking, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueReadImage");
 	if (!m_Format || !m_Desc) FATAL_ERROR("clBuffer is not an OpenCL image object (CopyToHostImage).");
 
 	CL_ERROR(
@@ -520,6 +613,7 @@ void clBuffer::CopyToHostImage(clCommandQueue* queue, void* dst, size_t origin[3
 }
 
 void clBuffer::CopyBufferToImage(clCommandQueue* queue, clBuffer* buffer, clBuffer* image, size_t imgDims[3], gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueCopyBufferToImage");
 
 	static const size_t origin[3] = { 0, 0, 0 };
 	CL_ERROR(
@@ -529,6 +623,7 @@ void clBuffer::CopyBufferToImage(clCommandQueue* queue, clBuffer* buffer, clBuff
 }
 
 void clBuffer::CopyBufferToImage(clCommandQueue* queue, clBuffer* buffer, clBuffer* image, size_t srcOffset, size_t dstOrigin[3], size_t dstRegion[3], gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueCopyBufferToImage");
 	CL_ERROR(
 		clEnqueueCopyBufferToImage(queue->GetCommandQueue(), buffer->GetBuffer(), image->GetBuffer(), srcOffset, dstOrigin, dstRegion, 0, NULL, pEvent),
 		"Failed to copy buffer to image."
@@ -536,6 +631,7 @@ void clBuffer::CopyBufferToImage(clCommandQueue* queue, clBuffer* buffer, clBuff
 }
 
 void clBuffer::CopyImageToBuffer(clCommandQueue* queue, clBuffer* image, clBuffer* buffer, size_t imgDims[3], gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueCopyImageToBuffer");
 	static const size_t origin[3] = { 0, 0, 0 };
 	CL_ERROR(
 		clEnqueueCopyImageToBuffer(queue->GetCommandQueue(), image->GetBuffer(), buffer->GetBuffer(), origin, imgDims, 0, 0, NULL, pEvent),
@@ -544,6 +640,7 @@ void clBuffer::CopyImageToBuffer(clCommandQueue* queue, clBuffer* image, clBuffe
 }
 
 void clBuffer::CopyImageToBuffer(clCommandQueue* queue, clBuffer* image, clBuffer* buffer, size_t srcOrigin[3], size_t srcRegion[3], size_t dstOrigin, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueCopyImageToBuffer");
 	CL_ERROR(
 		clEnqueueCopyImageToBuffer(queue->GetCommandQueue(), image->GetBuffer(), buffer->GetBuffer(), srcOrigin, srcRegion, dstOrigin, 0, NULL, pEvent),
 		"Failed to copy image to buffer."
@@ -551,6 +648,7 @@ void clBuffer::CopyImageToBuffer(clCommandQueue* queue, clBuffer* image, clBuffe
 }
 
 void clBuffer::AcquireGLObject(clCommandQueue* queue, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueAcquireGLObjects");
 	CL_ERROR(
 		clEnqueueAcquireGLObjects(queue->GetCommandQueue(), 1, &m_Buffer, 0, NULL, pEvent),
 		"Failed to Acquire GL object."
@@ -558,6 +656,7 @@ void clBuffer::AcquireGLObject(clCommandQueue* queue, gpu_event* pEvent) {
 }
 
 void clBuffer::ReleaseGLObject(clCommandQueue* queue, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueReleaseGLObjects");
 	CL_ERROR(
 		clEnqueueReleaseGLObjects(queue->GetCommandQueue(), 1, &m_Buffer, 0, NULL, pEvent),
 		"Failed to Release GL object."
@@ -565,6 +664,7 @@ void clBuffer::ReleaseGLObject(clCommandQueue* queue, gpu_event* pEvent) {
 }
 
 void clBuffer::MapImage(clCommandQueue* queue, void*& dataPtr, bool writeOnly, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueMapImage");
 	cl_int errorCode;
 	size_t origin[3]{ 0, 0, 0 };
 	size_t region[3]{ m_Desc->image_width, m_Desc->image_height, m_Desc->image_depth };
@@ -572,14 +672,44 @@ void clBuffer::MapImage(clCommandQueue* queue, void*& dataPtr, bool writeOnly, g
 	CL_ERROR(errorCode, "Failed to create map gpu image buffer.");
 }
 
+void clBuffer::MapBuffer(clCommandQueue* queue, void*& dataPtr, MapFlags flags, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueMapBuffer");
+	cl_int errorCode;
+	dataPtr = clEnqueueMapBuffer(queue->GetCommandQueue(), m_Buffer, CL_TRUE, cl_map_flags(flags), 0, m_BufferSize, 0, NULL, pEvent, &errorCode);
+	CL_ERROR(errorCode, "Failed to map buffer.");
+}
+
 void clBuffer::UnmapBuffer(clCommandQueue* queue, void* dataPtr, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueUnmapMemObject");
 	cl_int errorCode;
 	clEnqueueUnmapMemObject(queue->GetCommandQueue(), m_Buffer, dataPtr, 0, NULL, pEvent);
 }
 #pragma endregion
 
+#pragma region Mapped Buffer
+clMappedBuffer::clMappedBuffer(clCommandQueue* queue, clBuffer* buffer, MapFlags flags, gpu_event* pEvent)
+	: m_Queue(queue), m_Buffer(buffer) {
+	m_Buffer->MapBuffer(m_Queue, m_DataPtr, flags, pEvent);
+}
+
+clMappedBuffer::clMappedBuffer(clMappedBuffer&& other) noexcept
+	: m_Queue(other.m_Queue), m_Buffer(other.m_Buffer), m_DataPtr(other.m_DataPtr) {
+	other.m_DataPtr = nullptr;
+}
+
+clMappedBuffer::~clMappedBuffer() {
+	Unmap();
+}
+
+void clMappedBuffer::Unmap(gpu_event* pEvent) {
+	if (!m_DataPtr) return;
+	m_Buffer->UnmapBuffer(m_Queue, m_DataPtr, pEvent);
+	m_DataPtr = nullptr;
+}
+#pragma endregion
+
 #pragma region Kernel
-clKernel::clKernel(clProgram* program, const char* kernelName) {
+clKernel::clKernel(clProgram* program, const char* kernelName) : m_Name(kernelName) {
 	cl_int errorCode;
 	m_Kernel = clCreateKernel(program->GetProgram(), kernelName, &errorCode);
 	CL_ERROR(errorCode, "Failed to create kernel.");
@@ -598,6 +728,7 @@ void clKernel::SetArgument(unsigned int index, clBuffer* buffer) {
 }
 
 void clKernel::Enqueue(clCommandQueue* queue, size_t globalSize, size_t localSize, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueNDRangeKernel");
 	CL_ERROR(
 		clEnqueueNDRangeKernel(queue->GetCommandQueue(), m_Kernel, 1, NULL, &globalSize, &localSize, 0, nullptr, pEvent),
 		"Failed to enqueue kernel."
@@ -605,9 +736,28 @@ void clKernel::Enqueue(clCommandQueue* queue, size_t globalSize, size_t localSiz
 }
 
 void clKernel::Enqueue(clCommandQueue* queue, unsigned int workDim, size_t* globalWorkSize, size_t* localWorkSize, gpu_event* pEvent) {
+	TRACE_SCOPE("opencl", "clEnqueueNDRangeKernel");
 	CL_ERROR(
 		clEnqueueNDRangeKernel(queue->GetCommandQueue(), m_Kernel, workDim, NULL, globalWorkSize, localWorkSize, 0, nullptr, pEvent),
 		"Failed to enqueue kernel."
 	);
 }
+
+size_t clKernel::GetMaxWorkGroupSize(clContext* context) {
+	size_t size = 1;
+	CL_ERROR(
+		clGetKernelWorkGroupInfo(m_Kernel, context->GetDeviceID(), CL_KERNEL_WORK_GROUP_SIZE, sizeof(size), &size, NULL),
+		"Failed to retrieve kernel work-group size."
+	);
+	return size;
+}
+
+size_t clKernel::GetPreferredWorkGroupSizeMultiple(clContext* context) {
+	size_t multiple = 1;
+	CL_ERROR(
+		clGetKernelWorkGroupInfo(m_Kernel, context->GetDeviceID(), CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, sizeof(multiple), &multiple, NULL),
+		"Failed to retrieve preferred work-group size multiple."
+	);
+	return multiple;
+}
 #pragma endregion
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include <vector>
+#include <string>
 #include <CL/cl.h>
 
 typedef cl_event gpu_event;
@@ -64,6 +65,22 @@ enum class BufferFlags {
 	READ_WRITE = CL_MEM_READ_WRITE,
 };
 
+enum class HostMemory {
+	/** OpenCL allocates host-accessible (pinned) memory. Preferred on discrete GPUs. */
+	ALLOC_HOST_PTR = CL_MEM_ALLOC_HOST_PTR,
+	/** The buffer allocates aligned host memory itself and lets OpenCL use it as storage. Zero-copy on CPU devices. */
+	USE_HOST_PTR = CL_MEM_USE_HOST_PTR,
+};
+
+enum class MapFlags {
+	/** The host reads from the mapped region. */
+	READ = CL_MAP_READ,
+	/** The host writes to the mapped region. */
+	WRITE = CL_MAP_WRITE,
+	/** The host overwrites the entire mapped region, its previous contents are not transferred. */
+	WRITE_INVALIDATE = CL_MAP_WRITE_INVALIDATE_REGION,
+};
+
 class clContext {
 
 public:
@@ -85,6 +102,22 @@ public:
 	*/
 	const cl_context& GetContext() { return m_Context; }
 
+	/** Checks whether the device shares its memory with the host (CPU or integrated GPU), in which case mapping a buffer does not copy.
+	*/
+	bool HasHostUnifiedMemory();
+	/** Checks whether the device is a CPU device.
+	*/
+	bool IsCPUDevice();
+	/** Retrieves the number of compute units of the device.
+	*/
+	unsigned int GetComputeUnits();
+	/** Retrieves the name of the device.
+	*/
+	std::string GetDeviceName();
+	/** Retrieves the alignment in bytes that host memory should have to be used as buffer storage without copying.
+	*/
+	size_t GetHostPtrAlignment();
+
 private:
 	cl_platform_id m_PlatformID = 0;
 	cl_device_id m_DeviceID = 0;
@@ -105,8 +138,9 @@ public:
 	/** Creates an OpenCL context and constructs a program from the provided path.
 	* @param[in] context	Valid OpenCL context.
 	* @param[in] path		Path to the OpenCL source code.
+	* @param[in] defines	Additional build options, e.g. "-D NAME=value" macros specializing the program.
 	*/
-	clProgram(clContext* context, const char* path);
+	clProgram(clContext* context, const char* path, const char* defines = "");
 	~clProgram();
 
 	/** Retrieves the OpenCL program.
@@ -124,8 +158,9 @@ private:
 	void CreateProgram(clContext* context, const char* path);
 	/** Builds the cl_program.
 	* @param[in] context	Valid OpenCL context.
+	* @param[in] defines	Additional build options appended to the default options.
 	*/
-	void BuildProgram(clContext* context);
+	void BuildProgram(clContext* context, const char* defines);
 	/** Reads an OpenCL file and does some funky pre-processing. No idea where this method came from.
 	* @param[in] filePath		File path to the OpenCL file.
 	* @param[out] size			Pointer to where the size of the string should be stored. Cannot be NULL. I think.
@@ -170,6 +205,13 @@ public:
 	* @param[in] flags			Flags specifying use of the memory by OpenCL.
 	*/
 	clBuffer(clContext* context, size_t size, BufferFlags flags);
+	/** Creates an OpenCL memory buffer that is accessible by the host. Use clMappedBuffer to access its contents without copying.
+	* @param[in] context		Valid OpenCL context.
+	* @param[in] size			Size of the buffer in bytes.
+	* @param[in] flags			Flags specifying use of the memory by OpenCL.
+	* @param[in] hostMemory		Whether OpenCL allocates the host memory or the buffer provides aligned memory itself.
+	*/
+	clBuffer(clContext* context, size_t size, BufferFlags flags, HostMemory hostMemory);
 	/** Construct a buffer object from an OpenGL texture.
 	* @param[in] context		Valid OpenCL context.
 	* @param[in] glTexture			Valid OpenGL texture.
@@ -236,6 +278,14 @@ public:
 	*/
 	void CopyToHost(clCommandQueue* queue, void* dst, size_t offset, size_t size, bool blocking = true, gpu_event* pEvent = NULL);
 
+	/** Fills the entire buffer with a repeated pattern, without blocking.
+	* @param[in] queue			Valid command queue.
+	* @param[in] pattern		Pattern to fill the buffer with, copied when the command is enqueued.
+	* @param[in] patternSize	Size of the pattern in bytes, the buffer size should be a multiple of it.
+	* @param[out] pEvent		Profiling event used for retrieving profiling data.
+	*/
+	void Fill(clCommandQueue* queue, const void* pattern, size_t patternSize, gpu_event* pEvent = NULL);
+
 	/* Copy data from the host to the device image.
 	* @param[in] queue			Valid command queue.
 	* @param[in] src			Source buffer on host.
@@ -319,6 +369,13 @@ public:
 
 
 	void MapImage(clCommandQueue* queue, void*& dataPtr, bool writeOnly = true, gpu_event* pEvent = NULL);
+	/* Maps the buffer into host memory, blocks until the mapped region is accessible.
+	* @param[in] queue			Command queue used to perform the map operation on.
+	* @param[out] dataPtr		Pointer to the mapped region.
+	* @param[in] flags			Indicates how the host accesses the mapped region.
+	* @param[out] pEvent		Profiling event used for retrieving profiling data.
+	*/
+	void MapBuffer(clCommandQueue* queue, void*& dataPtr, MapFlags flags, gpu_event* pEvent = NULL);
 	/* Unmaps a region of pinned memory.
 	* @param[in] queue			Command queue used to perform the unmap operation on.
 	* @param[in] dataPtr		Pointer to the pinned memory region. Must be previously pinned by buffer object.
@@ -337,6 +394,8 @@ private:
 	cl_mem m_Buffer = 0;
 	/** Buffer size in bytes. */
 	size_t m_BufferSize;
+	/** Host memory owned by the buffer when created with HostMemory::USE_HOST_PTR. */
+	void* m_HostPtr = nullptr;
 
 	/* Image descriptor if the buffer is an OpenCL image.*/
 	cl_image_desc* m_Desc = nullptr;
@@ -345,6 +404,38 @@ private:
 
 };
 
+/** Maps a buffer on construction and unmaps it when going out of scope. */
+class clMappedBuffer {
+
+public:
+	/** Maps the buffer into host memory.
+	* @param[in] queue			Command queue used to perform the map and unmap operations on.
+	* @param[in] buffer			Buffer to map.
+	* @param[in] flags			Indicates how the host accesses the mapped region.
+	* @param[out] pEvent		Profiling event used for retrieving profiling data of the map operation.
+	*/
+	clMappedBuffer(clCommandQueue* queue, clBuffer* buffer, MapFlags flags, gpu_event* pEvent = NULL);
+	clMappedBuffer(clMappedBuffer&& other) noexcept;
+	clMappedBuffer(const clMappedBuffer&) = delete;
+	clMappedBuffer& operator=(const clMappedBuffer&) = delete;
+	~clMappedBuffer();
+
+	/** Unmaps the buffer before going out of scope.
+	* @param[out] pEvent		Profiling event used for retrieving profiling data of the unmap operation.
+	*/
+	void Unmap(gpu_event* pEvent = NULL);
+
+	/** Retrieves the mapped region, NULL once unmapped.
+	*/
+	void* Get() { return m_DataPtr; }
+	template<typename T> T* As() { return (T*)m_DataPtr; }
+
+private:
+	clCommandQueue* m_Queue;
+	clBuffer* m_Buffer;
+	void* m_DataPtr = nullptr;
+};
+
 class clKernel {
 
 public:
@@ -383,7 +474,21 @@ public:
 	*/
 	void Enqueue(clCommandQueue* queue, unsigned int workDim, size_t* globalWorkSize, size_t* localWorkSize, gpu_event* pEvent = NULL);
 
+	/** Retrieves the maximum work-group size the kernel can be executed with on the device.
+	* @param[in] context		Valid OpenCL context.
+	*/
+	size_t GetMaxWorkGroupSize(clContext* context);
+	/** Retrieves the work-group size multiple the device prefers for this kernel, usually the warp or wavefront size.
+	* @param[in] context		Valid OpenCL context.
+	*/
+	size_t GetPreferredWorkGroupSizeMultiple(clContext* context);
+
+	/** Retrieves the name of the kernel.
+	*/
+	const std::string& GetName() { return m_Name; }
+
 private:
 	cl_kernel m_Kernel = 0;
+	std::string m_Name;
 
 };
@@ -0,0 +1,117 @@
+#include "oclProfiler.h"
+#include "incl.h"
+#include "Trace.h"
+#include <algorithm>
+#include <fstream>
+
+void clProfiler::BeginFrame() {
+	m_Pending.clear();
+}
+
+gpu_event* clProfiler::Record(const char* name) {
+	m_Pending.push_back({ name, 0 });
+	return &m_Pending.back().event;
+}
+
+void clProfiler::EndFrame() {
+	TRACE_SCOPE("opencl", "profiler wait");
+	m_FrameCommands.clear();
+	m_FrameStats = clFrameStats();
+
+	for (PendingEvent& pending : m_Pending) {
+		// Slots that were never handed to a command stay empty.
+		if (!pending.event) continue;
+		CL_ERROR(clWaitForEvents(1, &pending.event), "Failed to wait for profiled command.");
+
+		clCommandRecord record;
+		record.name = pending.name;
+		record.frame = m_Frame;
+		record.queued = GetGPUProfilingTimeInformation(pending.event, GPU_PROFILING_COMMAND::QUEUED);
+		record.submit = GetGPUProfilingTimeInformation(pending.event, GPU_PROFILING_COMMAND::SUBMIT);
+		record.start = GetGPUProfilingTimeInformation(pending.event, GPU_PROFILING_COMMAND::START);
+		record.end = GetGPUProfilingTimeInformation(pending.event, GPU_PROFILING_COMMAND::END);
+		clReleaseEvent(pending.event);
+
+		m_FrameCommands.push_back(record);
+	}
+	m_Pending.clear();
+	m_Frame++;
+
+	if (m_FrameCommands.empty()) return;
+
+	// Sort by start time so the busy time is the union of the execution intervals.
+	std::vector<clCommandRecord> sorted = m_FrameCommands;
+	std::sort(sorted.begin(), sorted.end(), [](const clCommandRecord& a, const clCommandRecord& b) { return a.start < b.start; });
+
+	double first = sorted[0].queued, last = sorted[0].end;
+	double busy = 0.0, busyStart = sorted[0].start, busyEnd = sorted[0].end;
+	for (const clCommandRecord& c : sorted) {
+		m_FrameStats.commands++;
+		m_FrameStats.queueLatency += (c.start - c.queued) * 1e-6;
+		m_FrameStats.execution += (c.end - c.start) * 1e-6;
+		first = std::min(first, c.queued);
+		last = std::max(last, c.end);
+
+		if (c.start > busyEnd) {
+			busy += busyEnd - busyStart;
+			busyStart = c.start;
+		}
+		busyEnd = std::max(busyEnd, c.end);
+	}
+	busy += busyEnd - busyStart;
+
+	m_FrameStats.busy = busy * 1e-6;
+	m_FrameStats.overlap = m_FrameStats.execution - m_FrameStats.busy;
+	m_FrameStats.span = (last - first) * 1e-6;
+
+	if (m_Capturing)
+		for (const clCommandRecord& c : m_FrameCommands)
+			if (m_Captured.size() < m_MaxCaptured) m_Captured.push_back(c);
+}
+
+double clProfiler::GetExecutionTime(const char* name) {
+	double time = 0.0;
+	for (const clCommandRecord& c : m_FrameCommands)
+		if (c.name == name) time += (c.end - c.start) * 1e-6;
+	return time;
+}
+
+void clProfiler::StartCapture(size_t maxCommands) {
+	m_Captured.clear();
+	m_MaxCaptured = maxCommands;
+	m_Capturing = true;
+}
+
+void clProfiler::StopCapture() {
+	m_Capturing = false;
+}
+
+bool clProfiler::ExportChromeTrace(const char* path) {
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Could not write trace " << path << "." << std::endl;
+		return false;
+	}
+
+	double origin = m_Captured.empty() ? 0.0 : m_Captured[0].queued;
+	for (const clCommandRecord& c : m_Captured) origin = std::min(origin, c.queued);
+
+	// Commands are shown on the "device" track, the time they waited in the queue on the "queue" track. Timestamps in us.
+	file << "{\"traceEvents\":[\n";
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"device\"}},\n";
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"queue\"}}";
+	file.precision(3);
+	file << std::fixed;
+	for (const clCommandRecord& c : m_Captured) {
+		file << ",\n{\"name\":\"" << c.name << "\",\"cat\":\"opencl\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+			<< ",\"ts\":" << (c.start - origin) * 1e-3 << ",\"dur\":" << (c.end - c.start) * 1e-3
+			<< ",\"args\":{\"frame\":" << c.frame << ",\"submit_latency_us\":" << (c.submit - c.queued) * 1e-3 << "}}";
+		file << ",\n{\"name\":\"" << c.name << "\",\"cat\":\"queue\",\"ph\":\"X\",\"pid\":1,\"tid\":2"
+			<< ",\"ts\":" << (c.queued - origin) * 1e-3 << ",\"dur\":" << (c.start - c.queued) * 1e-3
+			<< ",\"args\":{\"frame\":" << c.frame << "}}";
+	}
+	file << "\n]}\n";
+
+	printf("Wrote %zu OpenCL commands to %s\n", m_Captured.size(), path);
+	return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "ocl.h"
+#include <deque>
+
+/** Profiling timestamps of a single OpenCL command, in ns on the device clock. */
+struct clCommandRecord {
+	std::string name;
+	unsigned int frame;
+	double queued, submit, start, end;
+};
+
+/** Aggregated profiling statistics of all commands in a frame, in ms. */
+struct clFrameStats {
+	/** Number of profiled commands. */
+	int commands = 0;
+	/** Summed time commands spent between being queued and starting. */
+	double queueLatency = 0.0;
+	/** Summed execution time of all commands. */
+	double execution = 0.0;
+	/** Time at least one command was executing. */
+	double busy = 0.0;
+	/** Execution time that overlapped with other commands, execution - busy. */
+	double overlap = 0.0;
+	/** Time from the first command being queued until the last one ended. */
+	double span = 0.0;
+};
+
+/** Collects the profiling events of every command in a frame and aggregates them.
+* <b>NOTE:</b> the command queue should be created with profiling enabled.
+*/
+class clProfiler {
+
+public:
+	/** Starts collecting events for a new frame. */
+	void BeginFrame();
+	/** Waits for all events of the frame, reads their timestamps, releases them and computes the frame statistics. */
+	void EndFrame();
+
+	/** Retrieves an event slot for a command, pass it as the pEvent parameter of the command.
+	* @param[in] name			Name of the command, shown in the statistics and trace.
+	* @returns					Event slot, owned by the profiler and valid until EndFrame.
+	*/
+	gpu_event* Record(const char* name);
+
+	/** Retrieves the statistics of the last completed frame. */
+	const clFrameStats& GetFrameStats() { return m_FrameStats; }
+	/** Retrieves the commands of the last completed frame. */
+	const std::vector<clCommandRecord>& GetFrameCommands() { return m_FrameCommands; }
+	/** Retrieves the execution time of a command in the last completed frame (in ms), 0 if it did not run. */
+	double GetExecutionTime(const char* name);
+
+	/** Starts keeping the commands of every frame for the trace export.
+	* @param[in] maxCommands	Maximum number of commands kept, later commands are dropped.
+	*/
+	void StartCapture(size_t maxCommands = 1 << 16);
+	/** Stops keeping commands for the trace export. */
+	void StopCapture();
+	/** Checks whether commands are being captured. */
+	bool IsCapturing() { return m_Capturing; }
+	/** Writes the captured commands as Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+	* @param[in] path			Output file path.
+	* @returns					true if the file was written.
+	*/
+	bool ExportChromeTrace(const char* path);
+
+private:
+	struct PendingEvent {
+		std::string name;
+		gpu_event event = 0;
+	};
+
+	/** Events recorded in the current frame, a deque so handed out slots stay valid. */
+	std::deque<PendingEvent> m_Pending;
+	std::vector<clCommandRecord> m_FrameCommands;
+	clFrameStats m_FrameStats;
+	unsigned int m_Frame = 0;
+
+	bool m_Capturing = false;
+	size_t m_MaxCaptured = 0;
+	std::vector<clCommandRecord> m_Captured;
+};
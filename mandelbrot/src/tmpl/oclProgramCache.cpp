@@ -0,0 +1,98 @@
+#include "oclProgramCache.h"
+#include "incl.h"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+/* Number of variants kept in the usage file and prebuilt on startup. */
+#define MAX_RECORDED_VARIANTS 8
+
+clProgramCache::clProgramCache(clContext* context, const char* path, const char* usagePath)
+	: m_Context(context), m_Path(path), m_UsagePath(usagePath) {
+	for (const std::string& defines : LoadUsage()) Prebuild(defines);
+}
+
+clProgramCache::~clProgramCache() {
+	for (auto& program : m_Programs)
+		delete program.second.get();
+}
+
+clProgram* clProgramCache::Get(const std::string& defines) {
+	return Find(defines, std::launch::deferred).get();
+}
+
+clProgram* clProgramCache::TryGet(const std::string& defines) {
+	std::shared_future<clProgram*> program = Find(defines, std::launch::async);
+	if (program.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return nullptr;
+	return program.get();
+}
+
+bool clProgramCache::HasFailed(const std::string& defines) {
+	std::shared_future<clProgram*> program;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto found = m_Programs.find(defines);
+		if (found == m_Programs.end()) return false;
+		program = found->second;
+	}
+	return program.wait_for(std::chrono::seconds(0)) == std::future_status::ready && program.get() == nullptr;
+}
+
+void clProgramCache::Prebuild(const std::string& defines) {
+	Find(defines, std::launch::async);
+}
+
+std::shared_future<clProgram*> clProgramCache::Find(const std::string& defines, std::launch policy) {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	auto program = m_Programs.find(defines);
+	if (program != m_Programs.end()) return program->second;
+
+	// Capture by value, the build may outlive this call. The destructor waits for all builds, so this stays valid.
+	clContext* context = m_Context;
+	std::string path = m_Path;
+	std::shared_future<clProgram*> build = std::async(policy, [context, path, defines]() -> clProgram* {
+		try {
+			return new clProgram(context, path.c_str(), defines.c_str());
+		}
+		catch (const std::exception& e) {
+			std::cerr << "Failed to build program variant " << defines << ":\n" << e.what() << std::endl;
+			return nullptr;
+		}
+		catch (...) {
+			std::cerr << "Failed to build program variant " << defines << "." << std::endl;
+			return nullptr;
+		}
+	}).share();
+
+	m_Programs[defines] = build;
+	return build;
+}
+
+void clProgramCache::RecordUsage(const std::string& defines) {
+	std::vector<std::string> variants = LoadUsage();
+	if (!variants.empty() && variants.back() == defines) return;
+
+	// Move the variant to the end and drop the least recently used ones.
+	variants.erase(std::remove(variants.begin(), variants.end(), defines), variants.end());
+	variants.push_back(defines);
+	if (variants.size() > MAX_RECORDED_VARIANTS) variants.erase(variants.begin(), variants.end() - MAX_RECORDED_VARIANTS);
+
+	std::ofstream file(m_UsagePath, std::ios::out | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Could not write " << m_UsagePath << "." << std::endl;
+		return;
+	}
+	for (const std::string& variant : variants) file << variant << "\n";
+}
+
+std::vector<std::string> clProgramCache::LoadUsage() {
+	std::vector<std::string> variants;
+	std::ifstream file(m_UsagePath, std::ios::in);
+	std::string line;
+	while (file.is_open() && std::getline(file, line))
+		if (!line.empty()) variants.push_back(line);
+	// Files written before the cap may hold more variants.
+	if (variants.size() > MAX_RECORDED_VARIANTS) variants.erase(variants.begin(), variants.end() - MAX_RECORDED_VARIANTS);
+	return variants;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "ocl.h"
+#include <map>
+#include <mutex>
+#include <future>
+
+/** Builds and keeps specializations of an OpenCL program, keyed by their build defines.
+* The last variants put to use are remembered on disk and prebuilt in the background on the next run.
+*/
+class clProgramCache {
+
+public:
+	/** Creates the cache and starts prebuilding the variants used in previous runs.
+	* @param[in] context		Valid OpenCL context.
+	* @param[in] path			Path to the OpenCL source code.
+	* @param[in] usagePath		Path to the list of previously used variants.
+	*/
+	clProgramCache(clContext* context, const char* path, const char* usagePath);
+	/** Waits for background builds and releases all programs. */
+	~clProgramCache();
+
+	/** Retrieves a program variant, builds it first if needed.
+	* @param[in] defines		Build defines of the variant, e.g. "-D NAME=value".
+	* @returns					The built program, owned by the cache. NULL if the build failed.
+	*/
+	clProgram* Get(const std::string& defines);
+	/** Retrieves a program variant without blocking, starts building it in the background if needed.
+	* @param[in] defines		Build defines of the variant.
+	* @returns					The built program, NULL while it is still being built or if the build failed.
+	*/
+	clProgram* TryGet(const std::string& defines);
+	/** Checks whether the build of a program variant has finished and failed, as opposed to still running.
+	* @param[in] defines		Build defines of the variant.
+	*/
+	bool HasFailed(const std::string& defines);
+	/** Starts building a program variant in the background.
+	* @param[in] defines		Build defines of the variant.
+	*/
+	void Prebuild(const std::string& defines);
+	/** Records that a variant was put to use, only the most recent ones are kept in the usage file.
+	* @param[in] defines		Build defines of the variant.
+	*/
+	void RecordUsage(const std::string& defines);
+
+private:
+	clContext* m_Context;
+	std::string m_Path, m_UsagePath;
+
+	std::mutex m_Mutex;
+	std::map<std::string, std::shared_future<clProgram*>> m_Programs;
+
+	/** Finds or starts the build of a variant and records its use.
+	* @param[in] defines		Build defines of the variant.
+	* @param[in] policy			Launch policy of the build if it is not in the cache yet.
+	*/
+	std::shared_future<clProgram*> Find(const std::string& defines, std::launch policy);
+	/** Reads the variants in the usage file, the most recently used last. */
+	std::vector<std::string> LoadUsage();
+};
@@ -0,0 +1,125 @@
+#include "oclTuner.h"
+#include "incl.h"
+#include <cerrno>
+#include <cfloat>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+clWorkGroupTuner::clWorkGroupTuner(clContext* context, const char* dbPath)
+	: m_Context(context), m_Path(dbPath) {
+	Load();
+}
+
+void clWorkGroupTuner::GetLocalSize(clCommandQueue* queue, clKernel* kernel, const std::string& variant, const size_t globalSize[2], size_t localSize[2]) {
+	auto entry = m_Entries.find(GetKey(kernel, variant, globalSize));
+	if (entry != m_Entries.end()) {
+		localSize[0] = entry->second.localSize[0];
+		localSize[1] = entry->second.localSize[1];
+		return;
+	}
+
+	Tune(queue, kernel, variant, globalSize, localSize);
+	Save();
+}
+
+void clWorkGroupTuner::Tune(clCommandQueue* queue, clKernel* kernel, const std::string& variant, const size_t globalSize[2], size_t localSize[2], int runs) {
+	size_t maxGroupSize = kernel->GetMaxWorkGroupSize(m_Context);
+	size_t multiple = kernel->GetPreferredWorkGroupSizeMultiple(m_Context);
+	size_t maxItemSizes[3] = { maxGroupSize, maxGroupSize, maxGroupSize };
+	clGetDeviceInfo(m_Context->GetDeviceID(), CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(maxItemSizes), maxItemSizes, NULL);
+
+	// Collect all power-of-two shapes that divide the global size. Groups smaller than a warp waste lanes, skip those unless nothing else fits.
+	std::vector<Entry> candidates;
+	for (size_t lx = 1; lx <= maxItemSizes[0] && lx <= globalSize[0]; lx <<= 1)
+		for (size_t ly = 1; ly <= maxItemSizes[1] && ly <= globalSize[1]; ly <<= 1) {
+			if (lx * ly > maxGroupSize || globalSize[0] % lx || globalSize[1] % ly) continue;
+			candidates.push_back({ { lx, ly }, 0.0 });
+		}
+
+	std::vector<Entry> filtered;
+	for (const Entry& c : candidates)
+		if (c.localSize[0] * c.localSize[1] >= multiple) filtered.push_back(c);
+	if (!filtered.empty()) candidates.swap(filtered);
+	if (candidates.empty()) candidates.push_back({ { 1, 1 }, 0.0 });
+
+	Entry best = { { candidates[0].localSize[0], candidates[0].localSize[1] }, DBL_MAX };
+	size_t global[2] = { globalSize[0], globalSize[1] };
+
+	for (Entry& c : candidates) {
+		c.time = DBL_MAX;
+		for (int r = 0; r < runs; r++) {
+			gpu_event event;
+			kernel->Enqueue(queue, 2, global, c.localSize, &event);
+			CL_ERROR(clWaitForEvents(1, &event), "Failed to wait for tuning run.");
+			double time = GetGPUCommandExecutionTime(event);
+			clReleaseEvent(event);
+			if (time < c.time) c.time = time;
+		}
+		if (c.time < best.time) best = c;
+	}
+
+	printf("Tuned %s (%zux%zu): local size %zux%zu, %.3f ms (%zu candidates)\n",
+		kernel->GetName().c_str(), globalSize[0], globalSize[1], best.localSize[0], best.localSize[1], best.time, candidates.size());
+
+	m_Entries[GetKey(kernel, variant, globalSize)] = best;
+	localSize[0] = best.localSize[0];
+	localSize[1] = best.localSize[1];
+}
+
+void clWorkGroupTuner::Save() {
+	std::ofstream file(m_Path, std::ios::out | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Could not write tuning database " << m_Path << "." << std::endl;
+		return;
+	}
+
+	for (const auto& entry : m_Entries)
+		file << entry.first << ';' << entry.second.localSize[0] << ';' << entry.second.localSize[1] << ';' << entry.second.time << "\n";
+}
+
+/* Parses a positive work size, false if the field is not entirely a number. */
+static bool ParseSize(const std::string& field, size_t& size) {
+	char* end;
+	errno = 0;
+	unsigned long long value = strtoull(field.c_str(), &end, 10);
+	if (field.empty() || *end || !value || field[0] == '-' || errno == ERANGE) return false;
+	size = (size_t)value;
+	return true;
+}
+
+/* Parses a non-negative time in ms, false if the field is not entirely a finite number. */
+static bool ParseTime(const std::string& field, double& time) {
+	char* end;
+	time = strtod(field.c_str(), &end);
+	return !field.empty() && !*end && time >= 0.0 && time < DBL_MAX;
+}
+
+void clWorkGroupTuner::Load() {
+	std::ifstream file(m_Path, std::ios::in);
+	if (!file.is_open()) return;
+
+	// Each line: device;kernel;variant;globalX;globalY;localX;localY;time. Lines of older databases without the variant,
+	// truncated or edited lines are skipped and tuned again.
+	std::string line;
+	int lineNumber = 0, skipped = 0;
+	while (std::getline(file, line)) {
+		lineNumber++;
+		std::vector<std::string> fields;
+		std::stringstream stream(line);
+		std::string field;
+		while (std::getline(stream, field, ';')) fields.push_back(field);
+
+		Entry entry;
+		if (fields.size() != 8 || !ParseSize(fields[5], entry.localSize[0]) || !ParseSize(fields[6], entry.localSize[1]) || !ParseTime(fields[7], entry.time)) {
+			skipped++;
+			continue;
+		}
+		m_Entries[fields[0] + ';' + fields[1] + ';' + fields[2] + ';' + fields[3] + ';' + fields[4]] = entry;
+	}
+	if (skipped) std::cerr << "Skipped " << skipped << " of " << lineNumber << " lines of tuning database " << m_Path << "." << std::endl;
+}
+
+std::string clWorkGroupTuner::GetKey(clKernel* kernel, const std::string& variant, const size_t globalSize[2]) {
+	return m_Context->GetDeviceName() + ';' + kernel->GetName() + ';' + variant + ';' + std::to_string(globalSize[0]) + ';' + std::to_string(globalSize[1]);
+}
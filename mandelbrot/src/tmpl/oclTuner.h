@@ -0,0 +1,56 @@
+#pragma once
+#include "ocl.h"
+#include <map>
+
+/** Finds the fastest local work size for a kernel on the current device by timing candidate work-group shapes.
+* Results are kept in a small text database so later runs do not need to tune again.
+*/
+class clWorkGroupTuner {
+
+public:
+	/** Creates the tuner and loads previously tuned work sizes.
+	* @param[in] context		Valid OpenCL context.
+	* @param[in] dbPath			Path to the tuning database. Created on the first Save if it does not exist.
+	*/
+	clWorkGroupTuner(clContext* context, const char* dbPath);
+
+	/** Retrieves the local work size for a kernel, tunes it first if it is not in the database.
+	* <b>NOTE:</b> the kernel arguments should be set, the kernel is executed while tuning.
+	* @param[in] queue			Command queue with profiling enabled.
+	* @param[in] kernel			Kernel to retrieve the local work size for.
+	* @param[in] variant		Build options of the kernel's program, variants of a kernel are tuned separately.
+	* @param[in] globalSize		Global work size in x and y.
+	* @param[out] localSize		Local work size in x and y.
+	*/
+	void GetLocalSize(clCommandQueue* queue, clKernel* kernel, const std::string& variant, const size_t globalSize[2], size_t localSize[2]);
+
+	/** Times all candidate local work sizes and stores the fastest in the database.
+	* @param[in] queue			Command queue with profiling enabled.
+	* @param[in] kernel			Kernel to tune.
+	* @param[in] variant		Build options of the kernel's program.
+	* @param[in] globalSize		Global work size in x and y.
+	* @param[out] localSize		Fastest local work size in x and y.
+	* @param[in] runs			Number of runs per candidate, the fastest run counts.
+	*/
+	void Tune(clCommandQueue* queue, clKernel* kernel, const std::string& variant, const size_t globalSize[2], size_t localSize[2], int runs = 5);
+
+	/** Writes the database to disk. */
+	void Save();
+
+private:
+	struct Entry {
+		size_t localSize[2];
+		/** Kernel execution time in ms. */
+		double time;
+	};
+
+	clContext* m_Context;
+	std::string m_Path;
+	/** Tuned work sizes by device, kernel, variant and global size. */
+	std::map<std::string, Entry> m_Entries;
+
+	/** Loads the database from disk, malformed lines are skipped. */
+	void Load();
+	/** Constructs the database key for a kernel variant and global size on the current device. */
+	std::string GetKey(clKernel* kernel, const std::string& variant, const size_t globalSize[2]);
+};